@@ -1,14 +1,27 @@
 #include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 std::random_device rndd;
 std::default_random_engine rnde(rndd());
 
@@ -27,20 +40,43 @@ double randdouble(double i, double j) {
     return dist(rnde);
 }
 
+// EUCLIDEAN is the exact distance used for generated and CSV cities,
+// the rest follow the TSPLIB EDGE_WEIGHT_TYPE definitions.
+enum class Metric : uint8_t {
+    EUCLIDEAN,
+    EUC_2D,
+    GEO,
+    ATT,
+};
+
 class City {
 private:
     std::string name;
     double x;
     double y;
+    double demand;
+    Metric metric;
 public:
-    City(const std::string& name, double x, double y) :
-    name(name), x(x), y(y)
+    City(const std::string& name, double x, double y, Metric metric = Metric::EUCLIDEAN, double demand = 0) :
+    name(name), x(x), y(y), demand(demand), metric(metric)
     {}
 
     double distance(const City &other) const {
         double dx = x - other.x;
         double dy = y - other.y;
-        return std::sqrt(dx * dx + dy * dy);
+        switch (metric) {
+            case Metric::EUC_2D:
+                return std::nearbyint(std::sqrt(dx * dx + dy * dy));
+            case Metric::ATT: {
+                double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+                double t = std::nearbyint(r);
+                return t < r ? t + 1 : t;
+            }
+            case Metric::GEO:
+                return geoDistance(other);
+            default:
+                return std::sqrt(dx * dx + dy * dy);
+        }
     }
 
     std::string getName() const {
@@ -54,19 +90,57 @@ public:
     double getY() const {
         return y;
     }
+
+    Metric getMetric() const {
+        return metric;
+    }
+
+    double getDemand() const {
+        return demand;
+    }
+
+    void setDemand(double value) {
+        demand = value;
+    }
+
+private:
+    static double geoRadians(double v) {
+        constexpr double PI = 3.141592;
+        double deg = std::trunc(v);
+        double min = v - deg;
+        return PI * (deg + 5.0 * min / 3.0) / 180.0;
+    }
+
+    double geoDistance(const City& other) const {
+        constexpr double RRR = 6378.388;
+        double lat1 = geoRadians(x), lon1 = geoRadians(y);
+        double lat2 = geoRadians(other.x), lon2 = geoRadians(other.y);
+        double q1 = std::cos(lon1 - lon2);
+        double q2 = std::cos(lat1 - lat2);
+        double q3 = std::cos(lat1 + lat2);
+        return (int)(RRR * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+    }
+};
+
+// A depot and vehicle capacity turn an Individual's tour into a giant tour that is
+// split optimally into capacity-feasible routes starting and ending at the depot.
+struct Routing {
+    const City* depot = nullptr;
+    double capacity = 0;
 };
 
 class Individual {
 private:
     std::vector<const City*> cities;
+    Routing routing;
     double fitness;
 public:
     Individual()
-    : cities(), fitness(0) {}
-    Individual(const std::vector<City>& arr)
-    : cities(ctor(arr)), fitness(totalDistance()) {}
-    Individual(const std::vector<const City*>& arr)
-    : cities(arr), fitness(totalDistance()) {}
+    : cities(), routing(), fitness(0) {}
+    Individual(const std::vector<City>& arr, const Routing& routing = {})
+    : cities(ctor(arr)), routing(routing), fitness(evaluate()) {}
+    Individual(const std::vector<const City*>& arr, const Routing& routing = {})
+    : cities(arr), routing(routing), fitness(evaluate()) {}
 
     static std::vector<const City*> ctor(const std::vector<City>& arr) {
         std::vector<const City*> cities;
@@ -80,10 +154,14 @@ public:
         return fitness;
     }
 
+    bool isRouting() const {
+        return routing.depot != nullptr;
+    }
+
     Individual shuffled () const {
         std::vector<const City*> cpy = cities;
         std::shuffle(cpy.begin(), cpy.end(), rnde);
-        return {cpy};
+        return {cpy, routing};
     }
 
     Individual mutated() const {
@@ -102,6 +180,27 @@ public:
         return copy;
     }
 
+    // Vehicle routes of the optimal split, each without the depot at its ends.
+    std::vector<std::vector<const City*>> getRoutes() const {
+        if (!isRouting()) {
+            return {cities};
+        }
+
+        std::vector<size_t> pred;
+        split(&pred);
+
+        std::vector<std::vector<const City*>> routes;
+        for (size_t j = cities.size(); j > 0; j = pred[j]) {
+            routes.emplace_back(cities.begin() + pred[j], cities.begin() + j);
+        }
+        std::reverse(routes.begin(), routes.end());
+        return routes;
+    }
+
+    const City* getDepot() const {
+        return routing.depot;
+    }
+
     bool operator<(const Individual& other) const {
         return this->getFitness() < other.getFitness();
     }
@@ -117,6 +216,8 @@ public:
     static Individual crossover(const Individual& parent1, const Individual& parent2) {
         std::vector<const City*> childCities;
         std::unordered_set<const City*> inChild;
+        childCities.reserve(parent1.cities.size());
+        inChild.reserve(parent1.cities.size());
 
         size_t crossoverPoint = randindex(parent1.cities.size());
 
@@ -132,16 +233,31 @@ public:
             }
         }
 
-        return {childCities};
+        return {childCities, parent1.routing};
     }
 
 private:
+    Individual(std::vector<const City*>&& arr, const Routing& routing, double fitness)
+    : cities(std::move(arr)), routing(routing), fitness(fitness) {}
+
+    // Plain tours only change in the edges touching the mutated positions, so their
+    // fitness is updated from those edges instead of the whole path.
     Individual mutated_swap() const {
         std::vector<const City*> cpy = cities;
         size_t i = randindex(cities.size());
         size_t j = randindex(cities.size());
+        if (isRouting()) {
+            std::swap(cpy[i], cpy[j]);
+            return {cpy, routing};
+        }
+
+        if (i > j) std::swap(i, j);
+        size_t edges[] = {i - 1, i, j - 1, j};
+        auto end = std::unique(std::begin(edges), std::end(edges));
+        double delta = -edgesLength(cpy, edges, end);
         std::swap(cpy[i], cpy[j]);
-        return {cpy};
+        delta += edgesLength(cpy, edges, end);
+        return {std::move(cpy), routing, fitness + delta};
     }
 
     Individual mutated_reverse() const {
@@ -149,26 +265,108 @@ private:
         size_t i = randindex(cities.size());
         size_t j = randindex(cities.size());
         if (i > j) std::swap(i, j);
+        if (isRouting()) {
+            std::reverse(cpy.begin() + i, cpy.begin() + j);
+            return {cpy, routing};
+        }
+
+        size_t edges[] = {i - 1, j - 1};
+        double delta = -edgesLength(cpy, std::begin(edges), std::end(edges));
         std::reverse(cpy.begin() + i, cpy.begin() + j);
-        return {cpy};
+        delta += edgesLength(cpy, std::begin(edges), std::end(edges));
+        return {std::move(cpy), routing, fitness + delta};
+    }
+
+    // Sums the edges (k, k + 1) for the given k, skipping those outside the path.
+    static double edgesLength(const std::vector<const City*>& path, const size_t* begin, const size_t* end) {
+        double dist = 0.0;
+        for (const size_t* k = begin; k != end; ++k) {
+            if (*k < path.size() && *k + 1 < path.size()) {
+                dist += path[*k]->distance(*path[*k + 1]);
+            }
+        }
+        return dist;
+    }
+
+    double evaluate() const {
+        return isRouting() ? split() : totalDistance();
     }
 
     double totalDistance() const {
         double dist = 0.0;
-        for (size_t i = 0; i < cities.size() - 1; ++i) {
+        for (size_t i = 0; i + 1 < cities.size(); ++i) {
             const City& a = *cities[i];
             const City& b = *cities[i + 1];
             dist += a.distance(b);
         }
         return dist;
     }
+
+    // Prins' split in linear time: the route serving cities (i, j] costs
+    // key(i) + along[j] + d(c_j, depot) with key(i) = cost[i] + d(depot, c_i+1) - along[i+1],
+    // so the best predecessor for j is the minimum key over the capacity-feasible window,
+    // which only ever slides forward and is kept in a monotone deque.
+    double split(std::vector<size_t>* predOut = nullptr) const {
+        const size_t n = cities.size();
+        const City& depot = *routing.depot;
+
+        std::vector<double> along(n + 1, 0.0);
+        std::vector<double> load(n + 1, 0.0);
+        for (size_t k = 1; k <= n; ++k) {
+            load[k] = load[k - 1] + cities[k - 1]->getDemand();
+            along[k] = k == 1 ? 0.0 : along[k - 1] + cities[k - 2]->distance(*cities[k - 1]);
+        }
+
+        std::vector<double> cost(n + 1, std::numeric_limits<double>::max());
+        std::vector<size_t> pred(n + 1, 0);
+        auto key = [&](size_t i) {
+            return cost[i] + depot.distance(*cities[i]) - along[i + 1];
+        };
+
+        cost[0] = 0;
+        std::vector<size_t> window(n + 1);
+        size_t front = 0, back = 0;
+        window[back++] = 0;
+        for (size_t j = 1; j <= n; ++j) {
+            while (front < back && load[j] - load[window[front]] > routing.capacity) {
+                ++front;
+            }
+            if (front == back) {
+                // A single stop exceeds the capacity; serve it alone anyway. The window is
+                // empty, so it restarts at the front of the buffer.
+                front = back = 0;
+                window[back++] = j - 1;
+            }
+
+            size_t i = window[front];
+            cost[j] = key(i) + along[j] + cities[j - 1]->distance(depot);
+            pred[j] = i;
+
+            if (j < n) {
+                double keyJ = key(j);
+                while (front < back && key(window[back - 1]) >= keyJ) {
+                    --back;
+                }
+                window[back++] = j;
+            }
+        }
+
+        if (predOut) {
+            *predOut = std::move(pred);
+        }
+        return cost[n];
+    }
 };
 
 struct Result {
     const Individual finalBest;
     const std::vector<double> bestPerGen;
+    const bool timedOut;
 };
 
+// Called with the generation number and the new best tour every time the best improves.
+using ImprovementCallback = std::function<void(size_t, const Individual&)>;
+
 class Solver {
 private:
     const int populationSize;
@@ -176,45 +374,78 @@ private:
     const int tournamentSize;
     const int noImprovementMax;
     const double mutationRate;
+    const double convergenceEpsilon;
+    const std::chrono::duration<double> timeBudget;
+    ImprovementCallback onImprovement;
 
 public:
     Solver(int populationSize = 5000,
            double selectionFactor = 0.75,
            double tournamentSize = 3,
            int convergenceThreshold = 15,
-           double mutationRate = 0.1) :
+           double mutationRate = 0.1,
+           double convergenceEpsilon = 1e-9,
+           double timeBudget = 0) :
     populationSize(populationSize),
-    truncatedSize(populationSize * selectionFactor),
+    truncatedSize(std::clamp((int)(populationSize * selectionFactor), 1, std::max(populationSize, 1))),
     tournamentSize(tournamentSize),
     noImprovementMax(convergenceThreshold),
-    mutationRate(mutationRate)
+    mutationRate(mutationRate),
+    convergenceEpsilon(convergenceEpsilon),
+    timeBudget(timeBudget)
     {}
 
+    void setOnImprovement(ImprovementCallback callback) {
+        onImprovement = std::move(callback);
+    }
+
     Result solve(const std::vector<City>& cities) {
         Individual seed(cities);
         return geneticAlgorithm(seed);
     }
 
+    Result solve(const std::vector<City>& customers, const City& depot, double capacity) {
+        Individual seed(customers, {&depot, capacity});
+        return geneticAlgorithm(seed);
+    }
+
 private:
     Result geneticAlgorithm(const Individual& seed) {
+        using clock = std::chrono::steady_clock;
+        const auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(timeBudget);
+        const bool hasBudget = timeBudget.count() > 0;
+
         std::vector<double> bestPerGen;
         std::vector<Individual> population;
+        population.reserve(populationSize);
         for (size_t i = 0; i < populationSize; ++i) {
             population.push_back(seed.shuffled());
         }
 
         double prevBest = std::numeric_limits<double>::max();
         int noImprovement = 0;
+        bool timedOut = false;
         do {
-            std::sort(population.begin(), population.end());
+            // Only the survivors need to be ordered relative to the rest.
+            std::nth_element(population.begin(), population.begin() + truncatedSize, population.end());
+            auto bestIt = std::min_element(population.begin(), population.begin() + truncatedSize);
+            std::iter_swap(population.begin(), bestIt);
 
             double best = population.front().getFitness();
             bestPerGen.push_back(best);
-            if (best == prevBest) {
-                noImprovement++;
-            } else {
+            if (best < prevBest * (1 - convergenceEpsilon)) {
                 prevBest = best;
                 noImprovement = 0;
+                if (onImprovement) {
+                    onImprovement(bestPerGen.size(), population.front());
+                }
+            } else {
+                noImprovement++;
+            }
+
+            if (hasBudget && clock::now() >= deadline) {
+                timedOut = true;
+                break;
             }
 
             population.resize(truncatedSize);
@@ -234,53 +465,144 @@ private:
 
         Individual bestIndiv = *std::min_element(population.begin(), population.end());
 
-        return {bestIndiv, bestPerGen};
+        return {bestIndiv, bestPerGen, timedOut};
     }
 
-    Individual tournamentSelection(const std::vector<Individual>& population) {
-        std::vector<Individual> tournamentPool;
-        for (int i = 0; i < tournamentSize; ++i) {
-            tournamentPool.push_back(population[randindex(truncatedSize)]);
+    const Individual& tournamentSelection(const std::vector<Individual>& population) {
+        const Individual* best = &population[randindex(truncatedSize)];
+        for (int i = 1; i < tournamentSize; ++i) {
+            const Individual& candidate = population[randindex(truncatedSize)];
+            if (candidate < *best) {
+                best = &candidate;
+            }
         }
-        return *std::min_element(tournamentPool.begin(), tournamentPool.end());
+        return *best;
     }
 };
 
-std::vector<City> genCities(int N, int xyrange = 500) {
+std::vector<City> genCities(int N, int xyrange = 500, int maxDemand = 0) {
     std::vector<City> cities;
     cities.reserve(N);
 
     for (int i = 0; i < N; ++i) {
         double x = randdouble(0, xyrange);
         double y = randdouble(0, xyrange);
-        cities.emplace_back("", x, y);
+        double demand = maxDemand > 0 ? randint(1, maxDemand + 1) : 0;
+        cities.emplace_back("", x, y, Metric::EUCLIDEAN, demand);
     }
 
     return cities;
 }
 
-std::vector<City> readCities(const std::string& dataset) {
-    using namespace std;
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+public:
+    MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(p);
+                length = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data) {
+            munmap(const_cast<char*>(data), length);
+        }
+    }
+
+    bool isOpen() const {
+        return data != nullptr;
+    }
+
+    std::string_view view() const {
+        return {data, length};
+    }
+};
+
+class LineCursor {
+private:
+    std::string_view rest;
+public:
+    LineCursor(std::string_view text) : rest(text) {}
+
+    bool next(std::string_view& line) {
+        if (rest.empty()) {
+            return false;
+        }
+        size_t end = rest.find('\n');
+        line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return true;
+    }
+};
+
+static std::string_view trim(std::string_view sv) {
+    while (!sv.empty() && std::isspace((unsigned char)sv.front())) sv.remove_prefix(1);
+    while (!sv.empty() && std::isspace((unsigned char)sv.back())) sv.remove_suffix(1);
+    return sv;
+}
+
+static bool parseDouble(std::string_view& sv, double& out) {
+    while (!sv.empty() && (std::isspace((unsigned char)sv.front()) || sv.front() == '+')) {
+        sv.remove_prefix(1);
+    }
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out);
+    if (ec != std::errc()) {
+        return false;
+    }
+    sv.remove_prefix(ptr - sv.data());
+    return true;
+}
 
-    string nameFile = dataset + "_name.csv";
-    string xyFile = dataset + "_xy.csv";
+static bool endsWith(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size()
+        && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::vector<City> readCsvCities(const std::string& dataset) {
+    using namespace std;
 
-    ifstream nameStream(nameFile);
-    ifstream xyStream(xyFile);
+    MappedFile nameFile(dataset + "_name.csv");
+    MappedFile xyFile(dataset + "_xy.csv");
 
-    if (!nameStream || !xyStream) {
+    if (!nameFile.isOpen() || !xyFile.isOpen()) {
         cerr << "Error opening file." << endl;
         return {};
     }
 
     vector<City> cities;
-    string nameLine;
-    string xyLine;
-    while (getline(nameStream, nameLine) && getline(xyStream, xyLine)) {
+    LineCursor names(nameFile.view());
+    LineCursor xys(xyFile.view());
+    string_view nameLine;
+    string_view xyLine;
+    while (names.next(nameLine) && xys.next(xyLine)) {
         double x, y;
-        stringstream ss(xyLine);
-        if (ss >> x && ss.ignore(1) && ss >> y) {
-            cities.emplace_back(nameLine, x, y);
+        string_view rest = xyLine;
+        bool ok = parseDouble(rest, x) && !rest.empty() && rest.front() == ',';
+        if (ok) {
+            rest.remove_prefix(1);
+            ok = parseDouble(rest, y);
+        }
+        if (ok) {
+            cities.emplace_back(string(nameLine), x, y);
         } else {
             cerr << "Error reading xy " << xyLine << endl;
             return {};
@@ -290,6 +612,277 @@ std::vector<City> readCities(const std::string& dataset) {
     return cities;
 }
 
+// Vehicle data of a CVRP instance; a zero capacity means a plain TSP instance.
+struct Fleet {
+    double capacity = 0;
+    size_t depot = 0;
+};
+
+static std::vector<City> readTspCities(const std::string& path, Fleet& fleet) {
+    using namespace std;
+
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        cerr << "Error opening file." << endl;
+        return {};
+    }
+
+    enum class Section { HEADER, COORDS, DEMANDS, DEPOTS, OTHER };
+
+    Metric metric = Metric::EUC_2D;
+    size_t dimension = 0;
+    vector<City> cities;
+    vector<double> demands;
+    LineCursor lines(file.view());
+    string_view line;
+    Section section = Section::HEADER;
+    while (lines.next(line)) {
+        line = trim(line);
+        if (line.empty()) continue;
+        if (line == "EOF") break;
+
+        if (line == "NODE_COORD_SECTION") {
+            section = Section::COORDS;
+            cities.reserve(dimension);
+            continue;
+        }
+        if (line == "DEMAND_SECTION") {
+            section = Section::DEMANDS;
+            continue;
+        }
+        if (line == "DEPOT_SECTION") {
+            section = Section::DEPOTS;
+            continue;
+        }
+        if (line.ends_with("_SECTION")) {
+            section = Section::OTHER;
+            continue;
+        }
+
+        string_view rest = line;
+        double id, a, b;
+        switch (section) {
+            case Section::HEADER: {
+                size_t colon = line.find(':');
+                if (colon == string_view::npos) {
+                    continue;
+                }
+                string_view key = trim(line.substr(0, colon));
+                string_view value = trim(line.substr(colon + 1));
+                if (key == "DIMENSION") {
+                    from_chars(value.data(), value.data() + value.size(), dimension);
+                } else if (key == "CAPACITY") {
+                    parseDouble(value, fleet.capacity);
+                } else if (key == "EDGE_WEIGHT_TYPE") {
+                    if (value == "EUC_2D") metric = Metric::EUC_2D;
+                    else if (value == "GEO") metric = Metric::GEO;
+                    else if (value == "ATT") metric = Metric::ATT;
+                    else {
+                        cerr << "Unsupported EDGE_WEIGHT_TYPE " << value << endl;
+                        return {};
+                    }
+                }
+                break;
+            }
+            case Section::COORDS:
+                if (!(parseDouble(rest, id) && parseDouble(rest, a) && parseDouble(rest, b))) {
+                    cerr << "Error reading node " << line << endl;
+                    return {};
+                }
+                cities.emplace_back("", a, b, metric);
+                break;
+            case Section::DEMANDS:
+                if (!(parseDouble(rest, id) && parseDouble(rest, a))) {
+                    cerr << "Error reading demand " << line << endl;
+                    return {};
+                }
+                if (id >= 1 && (size_t)id <= dimension) {
+                    demands.resize(dimension, 0);
+                    demands[(size_t)id - 1] = a;
+                }
+                break;
+            case Section::DEPOTS:
+                if (parseDouble(rest, id) && id >= 1) {
+                    fleet.depot = (size_t)id - 1;
+                    section = Section::OTHER;
+                }
+                break;
+            case Section::OTHER:
+                break;
+        }
+    }
+
+    if (cities.empty()) {
+        cerr << "Missing NODE_COORD_SECTION." << endl;
+        return {};
+    }
+
+    for (size_t i = 0; i < cities.size() && i < demands.size(); ++i) {
+        cities[i].setDemand(demands[i]);
+    }
+    if (fleet.depot >= cities.size()) {
+        fleet.depot = 0;
+    }
+
+    return cities;
+}
+
+// Binary cache layout: magic, version, metric, capacity, depot, city count, then per city
+// x, y, demand, name length and name bytes.
+static constexpr char CACHE_MAGIC[4] = {'T', 'S', 'P', 'C'};
+static constexpr uint32_t CACHE_VERSION = 2;
+// x, y, demand and name length of a city with an empty name.
+static constexpr size_t CACHE_MIN_RECORD = 3 * sizeof(double) + sizeof(uint32_t);
+
+static std::vector<City> readCachedCities(const std::string& path, Fleet& fleet) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        return {};
+    }
+
+    std::string_view data = file.view();
+    auto take = [&](void* out, size_t n) {
+        if (data.size() < n) return false;
+        std::memcpy(out, data.data(), n);
+        data.remove_prefix(n);
+        return true;
+    };
+
+    char magic[4];
+    uint32_t version;
+    uint8_t metric;
+    double capacity;
+    uint64_t depot;
+    uint64_t count;
+    if (!take(magic, sizeof(magic)) || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0
+        || !take(&version, sizeof(version)) || version != CACHE_VERSION
+        || !take(&metric, sizeof(metric)) || !take(&capacity, sizeof(capacity))
+        || !take(&depot, sizeof(depot)) || !take(&count, sizeof(count))
+        || metric > (uint8_t)Metric::ATT || count > data.size() / CACHE_MIN_RECORD || depot >= count) {
+        return {};
+    }
+
+    std::vector<City> cities;
+    cities.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        double x, y, demand;
+        uint32_t nameLength;
+        if (!take(&x, sizeof(x)) || !take(&y, sizeof(y)) || !take(&demand, sizeof(demand))
+            || !take(&nameLength, sizeof(nameLength)) || data.size() < nameLength) {
+            return {};
+        }
+        cities.emplace_back(std::string(data.substr(0, nameLength)), x, y, (Metric)metric, demand);
+        data.remove_prefix(nameLength);
+    }
+
+    fleet.capacity = capacity;
+    fleet.depot = depot;
+    return cities;
+}
+
+static void writeCachedCities(const std::string& path, const std::vector<City>& cities, const Fleet& fleet) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out || cities.empty()) {
+        return;
+    }
+
+    uint8_t metric = (uint8_t)cities.front().getMetric();
+    uint64_t depot = fleet.depot;
+    uint64_t count = cities.size();
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    out.write((const char*)&CACHE_VERSION, sizeof(CACHE_VERSION));
+    out.write((const char*)&metric, sizeof(metric));
+    out.write((const char*)&fleet.capacity, sizeof(fleet.capacity));
+    out.write((const char*)&depot, sizeof(depot));
+    out.write((const char*)&count, sizeof(count));
+    for (const City& c : cities) {
+        double x = c.getX(), y = c.getY(), demand = c.getDemand();
+        std::string name = c.getName();
+        uint32_t nameLength = name.size();
+        out.write((const char*)&x, sizeof(x));
+        out.write((const char*)&y, sizeof(y));
+        out.write((const char*)&demand, sizeof(demand));
+        out.write((const char*)&nameLength, sizeof(nameLength));
+        out.write(name.data(), nameLength);
+    }
+}
+
+// The cache must be strictly newer than every source, to the nanosecond, so that a source
+// saved within the same timestamp tick as the cache is parsed again.
+static bool isCacheFresh(const std::string& cachePath, const std::vector<std::string>& sources) {
+    struct stat cacheStat;
+    if (stat(cachePath.c_str(), &cacheStat) != 0) {
+        return false;
+    }
+    auto mtime = [](const struct stat& st) {
+        return std::make_pair(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    };
+    for (const std::string& source : sources) {
+        struct stat sourceStat;
+        if (stat(source.c_str(), &sourceStat) != 0 || mtime(sourceStat) >= mtime(cacheStat)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads either a TSPLIB `.tsp`/`.vrp` file or a `<dataset>_name.csv`/`<dataset>_xy.csv` pair.
+// With useCache the parsed cities are stored in `<dataset>.bin` and reused while
+// it is newer than the source files.
+std::vector<City> readCities(const std::string& dataset, Fleet& fleet, bool useCache = false) {
+    bool isTsp = endsWith(dataset, ".tsp") || endsWith(dataset, ".vrp");
+    std::vector<std::string> sources = isTsp
+        ? std::vector<std::string>{dataset}
+        : std::vector<std::string>{dataset + "_name.csv", dataset + "_xy.csv"};
+    std::string cachePath = dataset + ".bin";
+
+    if (useCache && isCacheFresh(cachePath, sources)) {
+        std::vector<City> cities = readCachedCities(cachePath, fleet);
+        if (!cities.empty()) {
+            return cities;
+        }
+    }
+
+    std::vector<City> cities = isTsp ? readTspCities(dataset, fleet) : readCsvCities(dataset);
+    if (useCache && !cities.empty()) {
+        writeCachedCities(cachePath, cities, fleet);
+    }
+    return cities;
+}
+
+void printCity(std::ostream& out, const City& c) {
+    if (!c.getName().empty()) {
+        out << c.getName();
+    } else {
+        out << "(" << c.getX() << ", " << c.getY() << ")";
+    }
+}
+
+void printTour(std::ostream& out, const Individual& tour) {
+    if (tour.isRouting()) {
+        for (const auto& route : tour.getRoutes()) {
+            printCity(out, *tour.getDepot());
+            for (const City* c : route) {
+                out << " -> ";
+                printCity(out, *c);
+            }
+            out << " -> ";
+            printCity(out, *tour.getDepot());
+            out << std::endl;
+        }
+        return;
+    }
+
+    auto cities = tour.getCities();
+    for (int i = 0; i < cities.size(); i++) {
+        printCity(out, cities[i]);
+        if (i != cities.size() - 1) {
+            out << " -> ";
+        }
+    }
+    out << std::endl;
+}
+
 void printResult(const Result& result, int printSteps = 8) {
     using namespace std;
 
@@ -302,41 +895,260 @@ void printResult(const Result& result, int printSteps = 8) {
     }
     cout << endl;
 
-    auto cities = result.finalBest.getCities();
-    for (int i = 0; i < cities.size(); i++) {
-        const City& c = cities[i];
-        if (!c.getName().empty()) {
-            cout << c.getName();
-        } else {
-            cout << "(" << c.getX() << ", " << c.getY() << ")";
+    printTour(cout, result.finalBest);
+    cout << result.bestPerGen.back() << endl;
+}
+
+struct SolverParams {
+    int populationSize;
+    double selectionFactor;
+    int tournamentSize;
+    int convergenceThreshold;
+    double mutationRate;
+};
+
+struct BenchmarkInstance {
+    std::string name;
+    std::vector<City> cities;
+    double optimum;
+};
+
+struct BenchmarkRun {
+    std::vector<std::pair<double, double>> trace;
+    double length;
+    size_t generations;
+    double time;
+};
+
+struct BenchmarkOptions {
+    int runs = 5;
+    unsigned seed = 42;
+    std::vector<int> sizes = {20, 50};
+    std::vector<std::string> datasets = {"uk12"};
+    std::vector<int> populationSizes = {1000, 5000};
+    std::vector<double> selectionFactors = {0.5, 0.75};
+    std::vector<int> tournamentSizes = {3, 5};
+    std::vector<int> convergenceThresholds = {15};
+    std::vector<double> mutationRates = {0.05, 0.1, 0.2};
+};
+
+static void meanStdev(const std::vector<double>& values, double& mean, double& stdev) {
+    mean = stdev = std::numeric_limits<double>::quiet_NaN();
+    if (values.empty()) {
+        return;
+    }
+
+    mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    double sq_sum = 0.0;
+    for (double v : values) {
+        sq_sum += (v - mean) * (v - mean);
+    }
+    stdev = std::sqrt(sq_sum / values.size());
+}
+
+template <typename T>
+static std::vector<T> parseList(const std::string& str) {
+    std::vector<T> values;
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        std::stringstream ts(token);
+        T value;
+        if (ts >> value) {
+            values.push_back(value);
         }
-        if (i != cities.size() - 1) {
-            cout << " -> ";
+    }
+    return values;
+}
+
+static BenchmarkRun benchmarkRun(const BenchmarkInstance& instance, const SolverParams& params, unsigned seed) {
+    using clock = std::chrono::steady_clock;
+
+    rnde.seed(seed);
+    Solver solver(params.populationSize, params.selectionFactor, params.tournamentSize,
+                  params.convergenceThreshold, params.mutationRate);
+
+    BenchmarkRun run;
+    const auto start = clock::now();
+    solver.setOnImprovement([&](size_t, const Individual& best) {
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        run.trace.emplace_back(elapsed, best.getFitness());
+    });
+
+    Result result = solver.solve(instance.cities);
+    run.time = std::chrono::duration<double>(clock::now() - start).count();
+    run.length = result.finalBest.getFitness();
+    run.generations = result.bestPerGen.size();
+    run.trace.emplace_back(run.time, run.length);
+    return run;
+}
+
+// Sweeps the full grid of Solver parameters over every instance and prints one CSV row
+// per (instance, configuration). Every configuration sees the same per-run seeds.
+// Instances without a known optimum use the best length found by any run as the target.
+void runBenchmark(const BenchmarkOptions& opts) {
+    using namespace std;
+
+    vector<BenchmarkInstance> instances;
+    for (int n : opts.sizes) {
+        rnde.seed(opts.seed ^ n);
+        instances.push_back({"random" + to_string(n), genCities(n), 0});
+    }
+    for (const string& dataset : opts.datasets) {
+        Fleet fleet;
+        vector<City> cities = readCities(dataset, fleet);
+        if (cities.empty()) continue;
+        double optimum = dataset == "uk12" ? 1595.738522033024 : 0;
+        instances.push_back({dataset, std::move(cities), optimum});
+    }
+
+    vector<SolverParams> grid;
+    for (int pop : opts.populationSizes)
+    for (double sel : opts.selectionFactors)
+    for (int tour : opts.tournamentSizes)
+    for (int conv : opts.convergenceThresholds)
+    for (double mut : opts.mutationRates) {
+        grid.push_back({pop, sel, tour, conv, mut});
+    }
+
+    cout << "instance,populationSize,selectionFactor,tournamentSize,convergenceThreshold,mutationRate,"
+         << "runs,reachedOptimum,timeToOptimumMean,timeToOptimumStdev,lengthMean,lengthStdev,"
+         << "generationsMean,generationsStdev,timeMean,timeStdev" << endl;
+    cout << setprecision(10);
+
+    for (const BenchmarkInstance& instance : instances) {
+        vector<vector<BenchmarkRun>> runs;
+        double target = instance.optimum > 0 ? instance.optimum : numeric_limits<double>::max();
+        for (const SolverParams& params : grid) {
+            vector<BenchmarkRun>& configRuns = runs.emplace_back();
+            for (int r = 0; r < opts.runs; r++) {
+                configRuns.push_back(benchmarkRun(instance, params, opts.seed + r));
+                if (instance.optimum <= 0) {
+                    target = std::min(target, configRuns.back().length);
+                }
+            }
+        }
+
+        for (size_t g = 0; g < grid.size(); g++) {
+            const SolverParams& params = grid[g];
+            vector<double> timesToOptimum, lengths, generations, times;
+            for (const BenchmarkRun& run : runs[g]) {
+                auto hit = find_if(run.trace.begin(), run.trace.end(), [&](const auto& point) {
+                    return point.second <= target * (1 + 1e-9);
+                });
+                if (hit != run.trace.end()) {
+                    timesToOptimum.push_back(hit->first);
+                }
+                lengths.push_back(run.length);
+                generations.push_back(run.generations);
+                times.push_back(run.time);
+            }
+
+            double ttoMean, ttoStdev, lenMean, lenStdev, genMean, genStdev, timeMean, timeStdev;
+            meanStdev(timesToOptimum, ttoMean, ttoStdev);
+            meanStdev(lengths, lenMean, lenStdev);
+            meanStdev(generations, genMean, genStdev);
+            meanStdev(times, timeMean, timeStdev);
+
+            cout << instance.name << ","
+                 << params.populationSize << "," << params.selectionFactor << ","
+                 << params.tournamentSize << "," << params.convergenceThreshold << ","
+                 << params.mutationRate << ","
+                 << runs[g].size() << "," << timesToOptimum.size() << ","
+                 << ttoMean << "," << ttoStdev << ","
+                 << lenMean << "," << lenStdev << ","
+                 << genMean << "," << genStdev << ","
+                 << timeMean << "," << timeStdev << endl;
         }
     }
-    cout << endl;
-    cout << result.bestPerGen.back() << endl;
 }
 
 int main(int argc, const char* argv[]) {
     using namespace std;
     using namespace std::chrono;
 
-    bool isAutomatedTest = !(argc >= 2 && argv[1] == string("-t"));
+    if (argc >= 2 && argv[1] == string("--bench")) {
+        BenchmarkOptions opts;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            string key = argv[i];
+            string value = argv[i + 1];
+            if (key == "-runs") opts.runs = stoi(value);
+            else if (key == "-seed") opts.seed = stoul(value);
+            else if (key == "-n") opts.sizes = parseList<int>(value);
+            else if (key == "-datasets") opts.datasets = parseList<string>(value);
+            else if (key == "-pop") opts.populationSizes = parseList<int>(value);
+            else if (key == "-sel") opts.selectionFactors = parseList<double>(value);
+            else if (key == "-tour") opts.tournamentSizes = parseList<int>(value);
+            else if (key == "-conv") opts.convergenceThresholds = parseList<int>(value);
+            else if (key == "-mut") opts.mutationRates = parseList<double>(value);
+            else {
+                cerr << "Unknown benchmark option " << key << endl;
+                return -1;
+            }
+        }
+        runBenchmark(opts);
+        return 0;
+    }
+
+    bool isAutomatedTest = true;
+    bool useCache = false;
+    bool streamImprovements = false;
+    double timeBudget = 0;
+    double capacity = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] == string("-t")) isAutomatedTest = false;
+        if (argv[i] == string("-c")) useCache = true;
+        if (argv[i] == string("-s")) streamImprovements = true;
+        if (argv[i] == string("-b") && i + 1 < argc) timeBudget = atof(argv[++i]);
+        if (argv[i] == string("-q") && i + 1 < argc) capacity = atof(argv[++i]);
+    }
 
-    int N;
     std::string input;
     std::getline(std::cin, input);
-    std::stringstream ss(input);
 
-    std::vector<City> cities = ss >> N
-        ? genCities(N)
-        : readCities(input);
+    // Only a line that is a whole number, such as "100" but not "100k.tsp", asks for
+    // that many random cities; anything else names a dataset.
+    int N = 0;
+    std::string_view number = input;
+    number.remove_prefix(std::min(number.find_first_not_of(" \t"), number.size()));
+    number.remove_suffix(number.size() - std::min(number.find_last_not_of(" \t\r") + 1, number.size()));
+    const auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), N);
+    const bool isCount = !number.empty() && error == std::errc() && end == number.data() + number.size();
+
+    Fleet fleet;
+    std::vector<City> cities = isCount
+        ? genCities(N, 500, capacity > 0 ? 10 : 0)
+        : readCities(input, fleet, useCache);
     
     if (cities.empty()) return -1;
 
+    if (capacity > 0) {
+        fleet.capacity = capacity;
+    }
+
+    // CVRP instances keep the depot out of the giant tour.
+    std::vector<City> customers;
+    if (fleet.capacity > 0) {
+        cities[fleet.depot].setDemand(0);
+        for (size_t i = 0; i < cities.size(); i++) {
+            if (i != fleet.depot) {
+                customers.push_back(cities[i]);
+            }
+        }
+    }
+
+    Solver solver(5000, 0.75, 3, 15, 0.1, 1e-9, timeBudget);
+    if (streamImprovements) {
+        solver.setOnImprovement([](size_t generation, const Individual& best) {
+            cerr << generation << " " << best.getFitness() << ": ";
+            printTour(cerr, best);
+        });
+    }
+
     auto start = high_resolution_clock::now();
-    auto result = Solver().solve(cities);
+    auto result = fleet.capacity > 0
+        ? solver.solve(customers, cities[fleet.depot], fleet.capacity)
+        : solver.solve(cities);
     auto stop = high_resolution_clock::now();
     double time = duration<double>(stop - start).count();
     
@@ -344,6 +1156,9 @@ int main(int argc, const char* argv[]) {
 
     if (!isAutomatedTest) {
         cout << "Exection time: " << time << "s" << endl;
+        if (result.timedOut) {
+            cout << "Stopped by time budget" << endl;
+        }
     }
 
     return 0;
@@ -1,98 +1,1716 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 constexpr int MIN = std::numeric_limits<int>::min();
 constexpr int MAX = std::numeric_limits<int>::max();
 
-constexpr char X = 'X';
-constexpr char O = 'O';
-constexpr char EMPTY = '_';
-constexpr const char* LINE_SEP = "=====";
+// Terminal scores are WIN plus the number of empty cells, so faster wins score higher.
+// Heuristic evaluations always stay strictly below WIN.
+constexpr int WIN = 1 << 28;
+
+constexpr char X = 'X';
+constexpr char O = 'O';
+constexpr char EMPTY = '_';
+constexpr const char* LINE_SEP = "=====";
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+
+// Fixed-size hash table of search results keyed by position hash. Each slot keeps the
+// deepest result of the current search and is overwritten by anything newer or deeper.
+//
+// The table is shared by all search threads without locks: a slot holds the packed
+// entry and the key xor-ed with it, so a slot torn by two racing writers fails the
+// key check on probe instead of returning a mixed-up entry.
+class TranspositionTable {
+public:
+  static constexpr uint16_t NO_MOVE = 0xFFFF;
+
+  enum class Bound : uint8_t {
+    EXACT,
+    LOWER,
+    UPPER,
+  };
+
+  struct Entry {
+    int32_t score = 0;
+    uint16_t move = NO_MOVE;
+    uint8_t depth = 0;
+    Bound bound = Bound::EXACT;
+  };
+
+private:
+  // Packed entry: score in bits 0-31, move 32-47, depth 48-55, bound 56-57,
+  // generation 58-62 and a used flag in bit 63.
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  static constexpr uint64_t USED = uint64_t(1) << 63;
+
+  std::unique_ptr<Slot[]> slots;
+  size_t size;
+  std::atomic<uint8_t> generation = 0;
+
+public:
+  TranspositionTable(size_t budgetBytes = 1 << 20)
+    : size(std::bit_floor(std::max<size_t>(budgetBytes / sizeof(Slot), 1)))
+  {
+    slots.reset(new Slot[size]());
+  }
+
+  void newSearch() {
+    generation.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool probe(uint64_t key, Entry& entry) const {
+    const Slot& slot = slots[key & (size - 1)];
+    const uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if (!(data & USED) || (slot.check.load(std::memory_order_relaxed) ^ data) != key) {
+      return false;
+    }
+    entry.score = (int32_t)(uint32_t)data;
+    entry.move = (uint16_t)(data >> 32);
+    entry.depth = (uint8_t)(data >> 48);
+    entry.bound = (Bound)(data >> 56 & 3);
+    return true;
+  }
+
+  // Depths beyond 255 plies are stored as 255.
+  void store(uint64_t key, int score, int depth, Bound bound, uint16_t move) {
+    depth = std::clamp(depth, 0, (int)UINT8_MAX);
+    Slot& slot = slots[key & (size - 1)];
+    const uint64_t gen = generation.load(std::memory_order_relaxed) & 31;
+    const uint64_t old = slot.data.load(std::memory_order_relaxed);
+    if ((old & USED) && (slot.check.load(std::memory_order_relaxed) ^ old) != key &&
+        (old >> 58 & 31) == gen && (uint8_t)(old >> 48) > depth) {
+      return;
+    }
+    const uint64_t data = (uint32_t)score | (uint64_t)move << 32 | (uint64_t)(uint8_t)depth << 48 |
+                          (uint64_t)bound << 56 | gen << 58 | USED;
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+  }
+};
+
+
+// Fixed-capacity bitset over board cells with the few operations the engine needs.
+struct Bitboard {
+  static constexpr size_t WORDS = 4;
+  static constexpr size_t CAPACITY = 64 * WORDS;
+
+  std::array<uint64_t, WORDS> words{};
+
+  void set(size_t i) {
+    words[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+
+  void reset(size_t i) {
+    words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+  }
+
+  bool test(size_t i) const {
+    return words[i >> 6] >> (i & 63) & 1;
+  }
+
+  bool any() const {
+    return std::any_of(words.begin(), words.end(), [](uint64_t w) { return w != 0; });
+  }
+
+  size_t count() const {
+    size_t n = 0;
+    for (uint64_t w : words) n += std::popcount(w);
+    return n;
+  }
+
+  Bitboard operator&(const Bitboard& other) const {
+    Bitboard r;
+    for (size_t i = 0; i < WORDS; ++i) r.words[i] = words[i] & other.words[i];
+    return r;
+  }
+
+  Bitboard operator|(const Bitboard& other) const {
+    Bitboard r;
+    for (size_t i = 0; i < WORDS; ++i) r.words[i] = words[i] | other.words[i];
+    return r;
+  }
+
+  Bitboard& operator|=(const Bitboard& other) {
+    for (size_t i = 0; i < WORDS; ++i) words[i] |= other.words[i];
+    return *this;
+  }
+
+  Bitboard without(const Bitboard& other) const {
+    Bitboard r;
+    for (size_t i = 0; i < WORDS; ++i) r.words[i] = words[i] & ~other.words[i];
+    return r;
+  }
+
+  bool operator==(const Bitboard& other) const = default;
+
+  // Index of the n-th set bit, counting from zero; n must be below count().
+  size_t nth(size_t n) const {
+    for (size_t i = 0;; ++i) {
+      const size_t inWord = std::popcount(words[i]);
+      if (n < inWord) {
+        uint64_t w = words[i];
+        for (; n; --n) w &= w - 1;
+        return i * 64 + std::countr_zero(w);
+      }
+      n -= inWord;
+    }
+  }
+
+  template <typename F>
+  void forEach(F f) const {
+    for (size_t i = 0; i < WORDS; ++i) {
+      for (uint64_t w = words[i]; w; w &= w - 1) {
+        f(i * 64 + std::countr_zero(w));
+      }
+    }
+  }
+};
+
+
+// Everything about an m,n,k board that does not change during a game: winning lines,
+// the lines through each cell, symmetry permutations, Zobrist keys and the powers of
+// three that give each position its base-3 tablebase index.
+struct Geometry {
+  size_t rows;
+  size_t cols;
+  size_t k;
+  size_t cells;
+  Bitboard full;
+  std::vector<Bitboard> lines;
+  std::vector<std::vector<uint16_t>> linesThrough;
+  std::vector<Bitboard> near;
+  std::vector<std::vector<uint16_t>> symmetries;
+  std::vector<std::vector<uint16_t>> inverse;
+  std::array<std::vector<uint64_t>, 2> zobrist;
+  std::vector<uint64_t> powers3;
+
+  static std::shared_ptr<const Geometry> create(size_t rows, size_t cols, size_t k) {
+    if (rows == 0 || cols == 0 || rows * cols > Bitboard::CAPACITY) {
+      throw std::invalid_argument("Unsupported board size.");
+    }
+    // Stones on a line are counted in a uint8_t.
+    if (k == 0 || k > std::max(rows, cols) || k > UINT8_MAX) {
+      throw std::invalid_argument("Unsupported win length.");
+    }
+
+    auto g = std::make_shared<Geometry>();
+    g->rows = rows;
+    g->cols = cols;
+    g->k = k;
+    g->cells = rows * cols;
+    for (size_t i = 0; i < g->cells; ++i) {
+      g->full.set(i);
+    }
+
+    g->linesThrough.resize(g->cells);
+    const int directions[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    for (const auto& d : directions) {
+      for (int r = 0; r < (int)rows; ++r) {
+        for (int c = 0; c < (int)cols; ++c) {
+          const int er = r + d[0] * ((int)k - 1);
+          const int ec = c + d[1] * ((int)k - 1);
+          if (er < 0 || er >= (int)rows || ec < 0 || ec >= (int)cols) {
+            continue;
+          }
+          Bitboard line;
+          for (size_t i = 0; i < k; ++i) {
+            const size_t cell = (r + d[0] * i) * cols + (c + d[1] * i);
+            line.set(cell);
+            g->linesThrough[cell].push_back(g->lines.size());
+          }
+          g->lines.push_back(line);
+        }
+      }
+    }
+
+    g->near.resize(g->cells);
+    for (int r = 0; r < (int)rows; ++r) {
+      for (int c = 0; c < (int)cols; ++c) {
+        for (int dr = -2; dr <= 2; ++dr) {
+          for (int dc = -2; dc <= 2; ++dc) {
+            const int nr = r + dr, nc = c + dc;
+            if (nr >= 0 && nr < (int)rows && nc >= 0 && nc < (int)cols) {
+              g->near[r * cols + c].set(nr * cols + nc);
+            }
+          }
+        }
+      }
+    }
+
+    // Rectangles only have the identity, both flips and the half turn.
+    const size_t count = rows == cols ? 8 : 4;
+    g->symmetries.assign(count, std::vector<uint16_t>(g->cells));
+    g->inverse.assign(count, std::vector<uint16_t>(g->cells));
+    const size_t nr = rows - 1, nc = cols - 1;
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        const size_t cell = r * cols + c;
+        size_t mapped[8] = {
+          r * cols + c,
+          r * cols + (nc - c),
+          (nr - r) * cols + c,
+          (nr - r) * cols + (nc - c),
+          c * cols + r,
+          c * cols + (nr - r),
+          (nc - c) * cols + r,
+          (nc - c) * cols + (nr - r),
+        };
+        for (size_t s = 0; s < count; ++s) {
+          g->symmetries[s][cell] = mapped[s];
+          g->inverse[s][mapped[s]] = cell;
+        }
+      }
+    }
+
+    uint64_t state = 0x5EED;
+    for (auto& keys : g->zobrist) {
+      keys.resize(g->cells);
+      for (auto& key : keys) {
+        key = splitmix64(state);
+      }
+    }
+
+    // 3^40 is the largest power of three that fits in 64 bits.
+    if (g->cells <= 40) {
+      g->powers3.resize(g->cells + 1);
+      g->powers3[0] = 1;
+      for (size_t i = 1; i <= g->cells; ++i) {
+        g->powers3[i] = g->powers3[i - 1] * 3;
+      }
+    }
+
+    return g;
+  }
+};
+
+
+class Board {
+public:
+  using Move = uint16_t;
+
+  static constexpr size_t MAX_SYMMETRIES = 8;
+
+private:
+  std::shared_ptr<const Geometry> geo;
+  Bitboard xMask;
+  Bitboard oMask;
+  std::array<uint64_t, MAX_SYMMETRIES> hashes;
+  // Stones of X and O on every line, and the heuristic sum over all lines from X's side,
+  // both updated only for the lines through a changed cell.
+  std::vector<std::array<uint8_t, 2>> lineCounts;
+  int64_t heuristic;
+  // Sum of 3^cell times 1 for X and 2 for O; only kept when the board has 40 cells or fewer.
+  uint64_t index;
+  char toMove;
+  char winner;
+
+public:
+  Board(size_t rows = 3, size_t cols = 3, size_t k = 3)
+    : geo(Geometry::create(rows, cols, k)), hashes{}, lineCounts(geo->lines.size()),
+      heuristic(0), index(0), toMove(X), winner(EMPTY)
+  {}
+
+public:
+  size_t getRows() const {
+    return geo->rows;
+  }
+
+  size_t getCols() const {
+    return geo->cols;
+  }
+
+  size_t getCells() const {
+    return geo->cells;
+  }
+
+  const Geometry& getGeometry() const {
+    return *geo;
+  }
+
+  uint64_t tablebaseIndex() const {
+    return index;
+  }
+
+  size_t getEmptyCount() const {
+    return geo->cells - xMask.count() - oMask.count();
+  }
+
+  size_t getMoveSpace() const {
+    return geo->cells;
+  }
+
+  size_t getRemainingMoves() const {
+    return getEmptyCount();
+  }
+
+  char getToMove() const {
+    return toMove;
+  }
+
+  Bitboard empties() const {
+    return geo->full.without(xMask | oMask);
+  }
+
+  // Candidate moves for search. Large boards only consider cells within two
+  // steps of a stone, and the centre on an empty board.
+  Bitboard candidates() const {
+    const Bitboard occupied = xMask | oMask;
+    if (geo->cells <= 25) {
+      return empties();
+    }
+    if (!occupied.any()) {
+      Bitboard centre;
+      centre.set((geo->rows / 2) * geo->cols + geo->cols / 2);
+      return centre;
+    }
+    Bitboard area;
+    occupied.forEach([&](size_t cell) { area |= geo->near[cell]; });
+    return area.without(occupied);
+  }
+
+  // Brings the candidates() of the previous position up to date after cell was played.
+  void updateCandidates(Bitboard& moves, Move cell) const {
+    if (geo->cells > 25) {
+      moves |= geo->near[cell];
+    }
+    moves = moves.without(xMask | oMask);
+  }
+
+  bool isWinner(char ch) const {
+    return winner == ch;
+  }
+
+  bool isFilled() const {
+    return getEmptyCount() == 0;
+  }
+
+  bool isFinal() const {
+    return winner != EMPTY || isFilled();
+  }
+
+  bool isLegal(Move cell) const {
+    return !isFinal() && cell < geo->cells && empties().test(cell);
+  }
+
+  std::string movePrompt() const {
+    std::stringstream ss;
+    ss << "Your [" << toMove << "] move ― row[1-" << geo->rows << "] col[1-" << geo->cols << "]: ";
+    return ss.str();
+  }
+
+  bool readMove(std::istream& in, Move& cell) const {
+    size_t row, col;
+    in >> row >> col;
+    if (!in || row < 1 || row > geo->rows || col < 1 || col > geo->cols) {
+      return false;
+    }
+    cell = (row - 1) * geo->cols + (col - 1);
+    return true;
+  }
+
+  // In-place move for the side to move; the cell must be empty and undone with unmake().
+  void make(Move cell) {
+    const char ch = toMove;
+    mask(ch).set(cell);
+    toggleHash(ch, cell);
+    updateIndex(ch, cell, +1);
+    if (updateLines(ch, cell, +1) && winner == EMPTY) {
+      winner = ch;
+    }
+    toMove = opponent(ch);
+  }
+
+  void unmake(Move cell) {
+    const char ch = opponent(toMove);
+    mask(ch).reset(cell);
+    toggleHash(ch, cell);
+    updateIndex(ch, cell, -1);
+    updateLines(ch, cell, -1);
+    winner = EMPTY;
+    toMove = ch;
+  }
+
+  // Every cell is as good a first guess as any other; line heuristics order the rest.
+  int movePriority(Move) const {
+    return 0;
+  }
+
+  // Number of plies after which a winning score becomes final.
+  int provenDepth(int score) const {
+    return getEmptyCount() - (score - WIN);
+  }
+
+  int finalScore(char ch) const {
+    const int score = WIN + (int)getEmptyCount();
+    if (winner == ch) return score;
+    if (winner == opponent(ch)) return -score;
+    return 0;
+  }
+
+  // Sum over the lines still open for exactly one player, weighted by how filled they are.
+  int evaluate(char ch) const {
+    const int score = std::clamp<int64_t>(heuristic, -(WIN - 1), WIN - 1);
+    return ch == X ? score : -score;
+  }
+
+  // Same for all boards equivalent under rotation or reflection; sym receives the
+  // symmetry that maps this board onto the canonical one.
+  uint64_t canonicalHash(size_t& sym) const {
+    const size_t count = geo->symmetries.size();
+    sym = std::min_element(hashes.begin(), hashes.begin() + count) - hashes.begin();
+    return hashes[sym];
+  }
+
+  Move toCanonical(Move cell, size_t sym) const {
+    return geo->symmetries[sym][cell];
+  }
+
+  Move fromCanonical(Move cell, size_t sym) const {
+    return geo->inverse[sym][cell];
+  }
+
+  void print() const {
+    for (size_t r = 0; r < geo->rows; ++r) {
+      for (size_t c = 0; c < geo->cols; ++c) {
+        std::cout << at(r, c) << " ";
+      }
+      std::cout << std::endl;
+    }
+    std::cout << LINE_SEP << std::endl;
+  }
+
+  static char opponent(char ch) {
+    return ch == X ? O : X;
+  }
+
+private:
+  // 8 per stone, saturating above WIN so that long lines cannot overflow the sum.
+  static int64_t lineValue(const std::array<uint8_t, 2>& counts) {
+    if (counts[1] == 0 && counts[0] > 0) return int64_t(1) << std::min(3 * counts[0], 30);
+    if (counts[0] == 0 && counts[1] > 0) return -(int64_t(1) << std::min(3 * counts[1], 30));
+    return 0;
+  }
+
+  // Returns whether one of the updated lines became complete for ch.
+  bool updateLines(char ch, size_t cell, int delta) {
+    const size_t side = ch == X ? 0 : 1;
+    bool completed = false;
+    for (uint16_t line : geo->linesThrough[cell]) {
+      auto& counts = lineCounts[line];
+      heuristic -= lineValue(counts);
+      counts[side] += delta;
+      heuristic += lineValue(counts);
+      completed |= counts[side] == geo->k;
+    }
+    return completed;
+  }
+
+  void updateIndex(char ch, size_t cell, int delta) {
+    if (!geo->powers3.empty()) {
+      index += delta * (ch == X ? 1 : 2) * geo->powers3[cell];
+    }
+  }
+
+  void toggleHash(char ch, size_t cell) {
+    const auto& keys = geo->zobrist[ch == X ? 0 : 1];
+    for (size_t s = 0; s < geo->symmetries.size(); ++s) {
+      hashes[s] ^= keys[geo->symmetries[s][cell]];
+    }
+  }
+
+  char at(size_t r, size_t c) const {
+    if (xMask.test(r * geo->cols + c)) return X;
+    if (oMask.test(r * geo->cols + c)) return O;
+    return EMPTY;
+  }
+
+  const Bitboard& mask(char ch) const {
+    return ch == X ? xMask : oMask;
+  }
+
+  Bitboard& mask(char ch) {
+    return ch == X ? xMask : oMask;
+  }
+};
+
+
+// Static data of a Dots and Boxes grid of rows x cols boxes. Edges, boxes and dots are
+// all points of the doubled (2 * rows + 1) x (2 * cols + 1) grid, which makes the
+// symmetry permutations the same rotations and reflections as for the m,n,k board.
+struct DotsGeometry {
+  size_t rows;
+  size_t cols;
+  size_t edges;
+  size_t boxes;
+  Bitboard full;
+  std::vector<std::array<int16_t, 2>> edgeBoxes;
+  std::vector<std::array<uint16_t, 4>> boxEdges;
+  std::vector<std::vector<uint16_t>> edgeSymmetries;
+  std::vector<std::vector<uint16_t>> edgeInverse;
+  std::vector<std::vector<uint16_t>> boxSymmetries;
+  std::vector<uint64_t> edgeKeys;
+  std::array<std::vector<uint64_t>, 2> boxKeys;
+  uint64_t sideKey;
+
+  // Horizontal edges come first, row by row, then the vertical ones.
+  size_t horizontal(size_t r, size_t c) const {
+    return r * cols + c;
+  }
+
+  size_t vertical(size_t r, size_t c) const {
+    return (rows + 1) * cols + r * (cols + 1) + c;
+  }
+
+  static std::shared_ptr<const DotsGeometry> create(size_t rows, size_t cols) {
+    const size_t edges = 2 * rows * cols + rows + cols;
+    if (rows == 0 || cols == 0 || edges > Bitboard::CAPACITY) {
+      throw std::invalid_argument("Unsupported board size.");
+    }
+
+    auto g = std::make_shared<DotsGeometry>();
+    g->rows = rows;
+    g->cols = cols;
+    g->edges = edges;
+    g->boxes = rows * cols;
+    for (size_t i = 0; i < edges; ++i) {
+      g->full.set(i);
+    }
+
+    const size_t gr = 2 * rows + 1, gc = 2 * cols + 1;
+    std::vector<int> edgeAt(gr * gc, -1), boxAt(gr * gc, -1);
+    g->edgeBoxes.assign(edges, {-1, -1});
+    g->boxEdges.resize(g->boxes);
+    for (size_t r = 0; r <= rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        edgeAt[(2 * r) * gc + 2 * c + 1] = g->horizontal(r, c);
+      }
+    }
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c <= cols; ++c) {
+        edgeAt[(2 * r + 1) * gc + 2 * c] = g->vertical(r, c);
+      }
+    }
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        const size_t box = r * cols + c;
+        boxAt[(2 * r + 1) * gc + 2 * c + 1] = box;
+        g->boxEdges[box] = {
+          (uint16_t)g->horizontal(r, c), (uint16_t)g->horizontal(r + 1, c),
+          (uint16_t)g->vertical(r, c), (uint16_t)g->vertical(r, c + 1),
+        };
+        for (uint16_t e : g->boxEdges[box]) {
+          auto& adjacent = g->edgeBoxes[e];
+          adjacent[adjacent[0] < 0 ? 0 : 1] = box;
+        }
+      }
+    }
+
+    const size_t count = rows == cols ? 8 : 4;
+    g->edgeSymmetries.assign(count, std::vector<uint16_t>(edges));
+    g->edgeInverse.assign(count, std::vector<uint16_t>(edges));
+    g->boxSymmetries.assign(count, std::vector<uint16_t>(g->boxes));
+    const size_t nr = gr - 1, nc = gc - 1;
+    for (size_t r = 0; r < gr; ++r) {
+      for (size_t c = 0; c < gc; ++c) {
+        const size_t point = r * gc + c;
+        size_t mapped[8] = {
+          r * gc + c,
+          r * gc + (nc - c),
+          (nr - r) * gc + c,
+          (nr - r) * gc + (nc - c),
+          c * gc + r,
+          c * gc + (nr - r),
+          (nc - c) * gc + r,
+          (nc - c) * gc + (nr - r),
+        };
+        for (size_t s = 0; s < count; ++s) {
+          if (edgeAt[point] >= 0) {
+            g->edgeSymmetries[s][edgeAt[point]] = edgeAt[mapped[s]];
+            g->edgeInverse[s][edgeAt[mapped[s]]] = edgeAt[point];
+          } else if (boxAt[point] >= 0) {
+            g->boxSymmetries[s][boxAt[point]] = boxAt[mapped[s]];
+          }
+        }
+      }
+    }
+
+    uint64_t state = 0xD075;
+    g->edgeKeys.resize(edges);
+    for (auto& key : g->edgeKeys) {
+      key = splitmix64(state);
+    }
+    for (auto& keys : g->boxKeys) {
+      keys.resize(g->boxes);
+      for (auto& key : keys) {
+        key = splitmix64(state);
+      }
+    }
+    g->sideKey = splitmix64(state);
+
+    return g;
+  }
+};
+
+
+// Dots and Boxes position. Completing a box scores it and gives the same player
+// another move; box side counts are kept incrementally so completion is O(1).
+class DotsBoard {
+public:
+  using Move = uint16_t;
+
+  static constexpr size_t MAX_SYMMETRIES = 8;
+
+private:
+  struct Undo {
+    Move edge;
+    char mover;
+  };
+
+  std::shared_ptr<const DotsGeometry> geo;
+  Bitboard drawn;
+  std::vector<uint8_t> sides;
+  std::vector<char> owners;
+  std::array<int, 2> scores;
+  std::array<uint64_t, MAX_SYMMETRIES> hashes;
+  std::vector<Undo> undo;
+  char toMove;
+
+public:
+  DotsBoard(size_t rows = 3, size_t cols = 3)
+    : geo(DotsGeometry::create(rows, cols)), sides(geo->boxes, 0), owners(geo->boxes, EMPTY),
+      scores{0, 0}, hashes{}, toMove(X)
+  {}
+
+public:
+  size_t getRows() const {
+    return geo->rows;
+  }
+
+  size_t getCols() const {
+    return geo->cols;
+  }
+
+  const DotsGeometry& getGeometry() const {
+    return *geo;
+  }
+
+  size_t getMoveSpace() const {
+    return geo->edges;
+  }
+
+  // The drawn edges as a bit mask. Future play depends on nothing else, so this is
+  // the tablebase index of boards with at most 64 edges.
+  uint64_t tablebaseIndex() const {
+    return drawn.words[0];
+  }
+
+  size_t getRemainingMoves() const {
+    return geo->edges - drawn.count();
+  }
+
+  char getToMove() const {
+    return toMove;
+  }
+
+  Bitboard candidates() const {
+    return geo->full.without(drawn);
+  }
+
+  void updateCandidates(Bitboard& moves, Move edge) const {
+    moves.reset(edge);
+  }
+
+  bool isFinal() const {
+    return drawn == geo->full;
+  }
+
+  bool isLegal(Move edge) const {
+    return edge < geo->edges && !drawn.test(edge);
+  }
+
+  std::string movePrompt() const {
+    return "Please enter your move:\n";
+  }
+
+  // Moves are entered as <1 vertical | 2 horizontal> <column> <row>, all 1-based.
+  bool readMove(std::istream& in, Move& edge) const {
+    size_t dir, col, row;
+    in >> dir >> col >> row;
+    if (!in || col < 1 || row < 1) {
+      return false;
+    }
+    if (dir == 1 && row <= geo->rows && col <= geo->cols + 1) {
+      edge = geo->vertical(row - 1, col - 1);
+      return true;
+    }
+    if (dir == 2 && row <= geo->rows + 1 && col <= geo->cols) {
+      edge = geo->horizontal(row - 1, col - 1);
+      return true;
+    }
+    return false;
+  }
+
+  void make(Move edge) {
+    const char mover = toMove;
+    drawn.set(edge);
+    toggleEdge(edge);
+
+    bool completed = false;
+    for (int16_t box : geo->edgeBoxes[edge]) {
+      if (box >= 0 && ++sides[box] == 4) {
+        claim(box, mover);
+        completed = true;
+      }
+    }
+
+    if (!completed) {
+      switchSide();
+    }
+    undo.push_back({edge, mover});
+  }
+
+  void unmake(Move edge) {
+    const char mover = undo.back().mover;
+    undo.pop_back();
+    if (toMove != mover) {
+      switchSide();
+    }
+
+    for (int16_t box : geo->edgeBoxes[edge]) {
+      if (box >= 0 && sides[box]-- == 4) {
+        claim(box, mover);
+      }
+    }
+
+    drawn.reset(edge);
+    toggleEdge(edge);
+  }
+
+  // Captures first, then moves that give nothing away, then sacrifices of the
+  // shortest chains, so forced lines and loony endgames are searched best-first.
+  int movePriority(Move edge) const {
+    int captured = 0, opened = 0;
+    for (int16_t box : geo->edgeBoxes[edge]) {
+      if (box < 0) continue;
+      if (sides[box] == 3) ++captured;
+      if (sides[box] == 2) ++opened;
+    }
+    if (captured) {
+      return 2000 + captured;
+    }
+    if (!opened) {
+      return 1000;
+    }
+    return 1000 - (int)chainGivenAway(edge);
+  }
+
+  // The game always runs until every edge is drawn.
+  int provenDepth(int) const {
+    return getRemainingMoves();
+  }
+
+  int finalScore(char ch) const {
+    const int diff = boxDiff(ch);
+    if (diff > 0) return WIN + diff;
+    if (diff < 0) return -WIN + diff;
+    return 0;
+  }
+
+  int evaluate(char ch) const {
+    return 64 * boxDiff(ch);
+  }
+
+  uint64_t canonicalHash(size_t& sym) const {
+    const size_t count = geo->edgeSymmetries.size();
+    sym = std::min_element(hashes.begin(), hashes.begin() + count) - hashes.begin();
+    return hashes[sym];
+  }
+
+  Move toCanonical(Move edge, size_t sym) const {
+    return geo->edgeSymmetries[sym][edge];
+  }
+
+  Move fromCanonical(Move edge, size_t sym) const {
+    return geo->edgeInverse[sym][edge];
+  }
+
+  void print() const {
+    for (size_t r = 0; r <= geo->rows; ++r) {
+      std::string dots = "o";
+      for (size_t c = 0; c < geo->cols; ++c) {
+        dots += drawn.test(geo->horizontal(r, c)) ? " - o" : "   o";
+      }
+      std::cout << dots << std::endl;
+
+      if (r == geo->rows) {
+        break;
+      }
+
+      std::string walls;
+      for (size_t c = 0; c <= geo->cols; ++c) {
+        walls += drawn.test(geo->vertical(r, c)) ? '|' : ' ';
+        if (c < geo->cols) {
+          walls += ' ';
+          walls += owners[r * geo->cols + c] == EMPTY ? ' ' : owners[r * geo->cols + c];
+          walls += ' ';
+        }
+      }
+      walls.erase(walls.find_last_not_of(' ') + 1);
+      std::cout << walls << std::endl;
+    }
+    std::cout << LINE_SEP << std::endl;
+  }
+
+private:
+  int boxDiff(char ch) const {
+    const int diff = scores[0] - scores[1];
+    return ch == X ? diff : -diff;
+  }
+
+  // Toggles ownership of a box: claims it when free and releases it otherwise.
+  void claim(size_t box, char mover) {
+    const size_t side = mover == X ? 0 : 1;
+    const bool release = owners[box] != EMPTY;
+    owners[box] = release ? EMPTY : mover;
+    scores[side] += release ? -1 : 1;
+    for (size_t s = 0; s < geo->boxSymmetries.size(); ++s) {
+      hashes[s] ^= geo->boxKeys[side][geo->boxSymmetries[s][box]];
+    }
+  }
+
+  void toggleEdge(Move edge) {
+    for (size_t s = 0; s < geo->edgeSymmetries.size(); ++s) {
+      hashes[s] ^= geo->edgeKeys[geo->edgeSymmetries[s][edge]];
+    }
+  }
+
+  void switchSide() {
+    toMove = toMove == X ? O : X;
+    for (size_t s = 0; s < geo->edgeSymmetries.size(); ++s) {
+      hashes[s] ^= geo->sideKey;
+    }
+  }
+
+  // Boxes the opponent can take in a row after edge is drawn: follows each box that
+  // would get its third side through its missing side while the next box has two.
+  size_t chainGivenAway(Move edge) const {
+    size_t total = 0;
+    for (int16_t start : geo->edgeBoxes[edge]) {
+      if (start < 0 || sides[start] != 2) continue;
+
+      int box = start;
+      Move entered = edge;
+      size_t length = 0;
+      while (length < geo->boxes) {
+        ++length;
+        Move exit = entered;
+        for (uint16_t e : geo->boxEdges[box]) {
+          if (e != entered && !drawn.test(e)) {
+            exit = e;
+            break;
+          }
+        }
+        const auto& adjacent = geo->edgeBoxes[exit];
+        const int next = adjacent[0] == box ? adjacent[1] : adjacent[0];
+        if (exit == entered || next < 0 || next == start || sides[next] != 2) {
+          break;
+        }
+        box = next;
+        entered = exit;
+      }
+      total += length;
+    }
+    return total;
+  }
+};
+
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+  const char* data = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        madvise(p, st.st_size, MADV_RANDOM);
+        data = static_cast<const char*>(p);
+        length = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data) {
+      munmap(const_cast<char*>(data), length);
+    }
+  }
+
+  bool isOpen() const {
+    return data != nullptr;
+  }
+
+  const char* begin() const {
+    return data;
+  }
+
+  size_t size() const {
+    return length;
+  }
+};
+
+
+// Perfect-play table of a small game: the best move and value of every position, stored
+// at the position's tablebase index so a lookup is one array access. Tables are solved
+// offline by backward induction over the index space and memory-mapped when played.
+//
+// Values are from the side to move: for m,n,k games 1 + empty cells for a win, minus that
+// for a loss and 0 for a draw, so faster wins rank higher; for Dots and Boxes the net
+// boxes the side to move still gets from the drawn edges onwards.
+class Tablebase {
+public:
+  static constexpr uint8_t NO_MOVE = 0xFF;
+
+  struct Entry {
+    int8_t value;
+    uint8_t move;
+  };
+
+  // Largest tables generate() accepts: 3^16 and 2^26 positions.
+  static constexpr size_t MAX_CELLS = 16;
+  static constexpr size_t MAX_EDGES = 26;
 
-class Board {
 private:
-  static constexpr size_t SIZE = 3;
-  static int winnings[8][3][2];
+  enum Kind : uint32_t {
+    MNK = 1,
+    DOTS = 2,
+  };
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t k;
+    uint64_t size;
+  };
 
-  char board[SIZE][SIZE];
-  size_t emptyCount;
+  static constexpr char MAGIC[4] = {'H', 'W', '4', 'T'};
+  static constexpr uint32_t VERSION = 1;
+
+  MappedFile file;
+  const Entry* entries = nullptr;
+  uint64_t size = 0;
 
 public:
-  Board() : emptyCount(SIZE * SIZE) {
-    for (auto& arr : board)
-      std::fill(std::begin(arr), std::end(arr), EMPTY);
+  // Opens a table written by write() and checks that it was solved for the given board.
+  template <typename Position>
+  Tablebase(const std::string& path, const Position& empty) : file(path) {
+    if (!file.isOpen() || file.size() < sizeof(Header)) {
+      throw std::runtime_error("Cannot open tablebase " + path + ".");
+    }
+    Header header;
+    std::memcpy(&header, file.begin(), sizeof(Header));
+    const Header expected = headerFor(empty, 0);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        file.size() != sizeof(Header) + header.size * sizeof(Entry)) {
+      throw std::runtime_error("Corrupt tablebase " + path + ".");
+    }
+    if (header.kind != expected.kind || header.rows != expected.rows || header.cols != expected.cols ||
+        header.k != expected.k) {
+      throw std::runtime_error("Tablebase " + path + " is for a different board.");
+    }
+    entries = reinterpret_cast<const Entry*>(file.begin() + sizeof(Header));
+    size = header.size;
   }
 
-public:
-  size_t getEmptyCount() const {
-      return emptyCount;
+  template <typename Position>
+  bool lookup(const Position& board, typename Position::Move& move) const {
+    const uint64_t index = board.tablebaseIndex();
+    if (index >= size || entries[index].move == NO_MOVE) {
+      return false;
+    }
+    move = entries[index].move;
+    return true;
+  }
+
+  template <typename Position>
+  static void write(const std::string& path, const Position& empty, const std::vector<Entry>& table) {
+    std::ofstream out(path, std::ios::binary);
+    const Header header = headerFor(empty, table.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(Entry));
+    if (!out) {
+      throw std::runtime_error("Cannot write tablebase " + path + ".");
+    }
+  }
+
+  // Every position of an m,n,k board by base-3 index. A move only turns a 0 digit into 1
+  // or 2, so successors have larger indices and a single descending pass solves them all.
+  static std::vector<Entry> generate(const Board& empty) {
+    const Geometry& g = empty.getGeometry();
+    if (g.cells > MAX_CELLS) {
+      throw std::invalid_argument("Board too large for a tablebase.");
+    }
+    std::vector<uint32_t> lines;
+    for (const Bitboard& line : g.lines) {
+      lines.push_back(line.words[0]);
+    }
+    const auto hasLine = [&](uint32_t stones) {
+      return std::any_of(lines.begin(), lines.end(), [&](uint32_t line) { return (stones & line) == line; });
+    };
+
+    const uint64_t size = g.powers3[g.cells];
+    std::vector<Entry> table(size, {0, NO_MOVE});
+    for (uint64_t index = size; index-- > 0;) {
+      uint32_t xs = 0, os = 0;
+      for (uint64_t rest = index, cell = 0; rest; rest /= 3, ++cell) {
+        if (rest % 3 == 1) xs |= 1u << cell;
+        if (rest % 3 == 2) os |= 1u << cell;
+      }
+      const int xCount = std::popcount(xs), oCount = std::popcount(os);
+      if (xCount != oCount && xCount != oCount + 1) {
+        continue;
+      }
+      const bool xToMove = xCount == oCount;
+      const int empties = g.cells - xCount - oCount;
+      const bool moverWon = hasLine(xToMove ? os : xs);
+      if (hasLine(xToMove ? xs : os)) {
+        continue;
+      }
+      if (moverWon) {
+        table[index].value = -(1 + empties);
+        continue;
+      }
+      if (empties == 0) {
+        continue;
+      }
+
+      Entry best{std::numeric_limits<int8_t>::min(), NO_MOVE};
+      for (size_t cell = 0; cell < g.cells; ++cell) {
+        if ((xs | os) >> cell & 1) continue;
+        const uint64_t child = index + (xToMove ? 1 : 2) * g.powers3[cell];
+        const int value = -table[child].value;
+        if (value > best.value) {
+          best = {(int8_t)value, (uint8_t)cell};
+        }
+      }
+      table[index] = best;
+    }
+    return table;
   }
 
-  std::vector<Board> successors(char ch) const {
-    std::vector<Board> successors;
-    for (size_t r = 0; r < SIZE; ++r) {
-      for (size_t c = 0; c < SIZE; ++c) {
-        Board succ = *this;
-        if (succ.move(ch, r, c)) {
-            successors.push_back(succ);
+  // Every set of drawn edges of a Dots and Boxes board. Boxes already taken do not change
+  // the rest of the game, so the edge mask alone indexes the net score still to come.
+  static std::vector<Entry> generate(const DotsBoard& empty) {
+    const DotsGeometry& g = empty.getGeometry();
+    if (g.edges > MAX_EDGES) {
+      throw std::invalid_argument("Board too large for a tablebase.");
+    }
+    std::vector<uint64_t> boxMasks(g.boxes, 0);
+    for (size_t box = 0; box < g.boxes; ++box) {
+      for (uint16_t e : g.boxEdges[box]) boxMasks[box] |= uint64_t(1) << e;
+    }
+
+    const uint64_t size = uint64_t(1) << g.edges;
+    std::vector<Entry> table(size, {0, NO_MOVE});
+    for (uint64_t drawn = size - 1; drawn-- > 0;) {
+      Entry best{std::numeric_limits<int8_t>::min(), NO_MOVE};
+      for (size_t edge = 0; edge < g.edges; ++edge) {
+        if (drawn >> edge & 1) continue;
+        const uint64_t child = drawn | uint64_t(1) << edge;
+        int gained = 0;
+        for (int16_t box : g.edgeBoxes[edge]) {
+          if (box >= 0 && (child & boxMasks[box]) == boxMasks[box]) ++gained;
+        }
+        const int value = gained ? gained + table[child].value : -table[child].value;
+        if (value > best.value) {
+          best = {(int8_t)value, (uint8_t)edge};
         }
       }
+      table[drawn] = best;
     }
+    return table;
+  }
 
-    return successors;
+private:
+  static Header headerFor(const Board& board, uint64_t size) {
+    const Geometry& g = board.getGeometry();
+    return {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, MNK, (uint32_t)g.rows, (uint32_t)g.cols,
+            (uint32_t)g.k, size};
   }
 
-  bool isWinner(char ch) const {
-    return std::any_of(std::begin(winnings), std::end(winnings), [&](auto& w) {
-      return std::all_of(std::begin(w), std::end(w), [&](auto& p) {
-        return board[p[0]][p[1]] == ch;
+  static Header headerFor(const DotsBoard& board, uint64_t size) {
+    return {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, DOTS, (uint32_t)board.getRows(),
+            (uint32_t)board.getCols(), 0, size};
+  }
+};
+
+
+// Iterative deepening alpha-beta with a time budget. Moves are ordered by the
+// transposition table move, then two killer moves per ply, then the position's own
+// move priority and finally the history heuristic.
+//
+// A Position is played in place with make()/unmake() and reports whose turn it is,
+// so games with extra turns are searched the same way as strictly alternating ones.
+//
+// With more than one thread the search is Lazy SMP: every thread runs its own
+// iterative deepening on a copy of the position, odd threads starting one ply deeper,
+// and they cooperate only through the shared transposition table. The main thread's
+// result is played. Each iteration after the first is searched with an aspiration
+// window around the previous score and widened when the score falls outside it.
+template <typename Position>
+class Search {
+private:
+  using Bound = TranspositionTable::Bound;
+  using Move = typename Position::Move;
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_t MAX_PLY = Bitboard::CAPACITY + 1;
+  static constexpr int ASPIRATION_WINDOW = 64;
+
+  // Per-thread search state.
+  struct Worker {
+    size_t nodes = 0;
+    size_t ttProbes = 0;
+    size_t ttHits = 0;
+    int depth = 0;
+    int score = 0;
+    std::vector<std::array<Move, 2>> killers;
+    std::vector<uint32_t> history;
+    std::vector<uint64_t> ranks;
+    std::vector<std::vector<Move>> moveBuffers;
+  };
+
+  TranspositionTable& tt;
+  const char computerCh;
+  const std::chrono::duration<double> timeBudget;
+  const size_t threads;
+
+  clock::time_point deadline;
+  std::atomic<bool> aborted = false;
+  std::vector<Worker> workers;
+
+public:
+  // Outcome of one search; the score is from the searching side's point of view.
+  struct Result {
+    Move move;
+    int score;
+    int depth;
+    size_t nodes;
+    double ttHitRate;
+    double seconds;
+  };
+
+  Search(TranspositionTable& tt, char computerCh, double timeBudget = 1.0, size_t threads = 1)
+    : tt(tt), computerCh(computerCh), timeBudget(timeBudget), threads(std::max<size_t>(threads, 1))
+  {}
+
+  Result analyze(const Position& board) {
+    const auto start = clock::now();
+    const Move move = bestMove(board);
+    const std::chrono::duration<double> elapsed = clock::now() - start;
+    return {move, getScore(), getDepth(), getNodes(), getTtHitRate(), elapsed.count()};
+  }
+
+  Move bestMove(Position board) {
+    tt.newSearch();
+    deadline = clock::now() + std::chrono::duration_cast<clock::duration>(timeBudget);
+    aborted = false;
+    workers.assign(threads, Worker{});
+
+    std::vector<std::thread> helpers;
+    for (size_t id = 1; id < threads; ++id) {
+      helpers.emplace_back([this, id, board]() mutable { iterate(workers[id], board, 1 + id % 2); });
+    }
+    Move best = iterate(workers[0], board, 1);
+    aborted = true;
+    for (std::thread& helper : helpers) {
+      helper.join();
+    }
+
+    if (best == TranspositionTable::NO_MOVE) {
+      board.candidates().forEach([&](size_t cell) {
+        if (best == TranspositionTable::NO_MOVE) best = cell;
       });
-    });
+    }
+    return best;
   }
 
-  bool isFilled() const {
-    return emptyCount == 0;
+  size_t getNodes() const {
+    size_t nodes = 0;
+    for (const Worker& w : workers) nodes += w.nodes;
+    return nodes;
   }
 
-  bool isFinal() const {
-    return isWinner(X) || isWinner(O) || isFilled();
+  double getTtHitRate() const {
+    size_t probes = 0, hits = 0;
+    for (const Worker& w : workers) {
+      probes += w.ttProbes;
+      hits += w.ttHits;
+    }
+    return probes ? (double)hits / probes : 0.0;
   }
 
-  bool move(char ch, size_t r, size_t c) {
-    if (r >= SIZE || c >= SIZE || board[r][c] != EMPTY) {
-      return false;
+  // Deepest iteration completed by the main thread in the last search.
+  int getDepth() const {
+    return workers.empty() ? 0 : workers[0].depth;
+  }
+
+  // Score of that iteration.
+  int getScore() const {
+    return workers.empty() ? 0 : workers[0].score;
+  }
+
+private:
+  Move iterate(Worker& w, Position& board, int startDepth) {
+    w.killers.assign(MAX_PLY, {TranspositionTable::NO_MOVE, TranspositionTable::NO_MOVE});
+    w.history.assign(board.getMoveSpace(), 0);
+    w.moveBuffers.resize(MAX_PLY);
+
+    Move best = TranspositionTable::NO_MOVE;
+    int bestScore = 0;
+    const int maxDepth = board.getRemainingMoves();
+    for (int depth = std::min(startDepth, maxDepth); depth <= maxDepth; ++depth) {
+      int window = ASPIRATION_WINDOW;
+      const bool aspirate = best != TranspositionTable::NO_MOVE && std::abs(bestScore) < WIN;
+      int alpha = aspirate ? bestScore - window : MIN;
+      int beta = aspirate ? bestScore + window : MAX;
+
+      int score;
+      Move move;
+      while (true) {
+        move = searchRoot(w, board, depth, best, alpha, beta, score);
+        if (aborted) {
+          break;
+        }
+        if (score <= alpha && alpha != MIN) {
+          window *= 4;
+          alpha = window >= WIN ? MIN : bestScore - window;
+        } else if (score >= beta && beta != MAX) {
+          window *= 4;
+          beta = window >= WIN ? MAX : bestScore + window;
+        } else {
+          break;
+        }
+      }
+      if (aborted) {
+        break;
+      }
+      best = move;
+      bestScore = score;
+      w.depth = depth;
+      w.score = score;
+      // Stop once a win is proven within the searched horizon; wins seen through deeper
+      // table entries and proven losses may still improve with more depth.
+      if (score >= WIN && board.provenDepth(score) <= depth) {
+        break;
+      }
     }
-    board[r][c] = ch;
-    --emptyCount;
-    return true;
+
+    return best;
   }
 
-  void print() const {
-    for (size_t r = 0; r < SIZE; ++r) {
-      for (size_t c = 0; c < SIZE; ++c) {
-        std::cout << board[r][c] << " ";
+  // Fail-soft search of the root moves, the previous best first. A score at or below
+  // alpha or at or above beta is only a bound and the caller searches again.
+  Move searchRoot(Worker& w, Position& board, int depth, Move previousBest, int alpha, int beta, int& bestScore) {
+    std::vector<Move> moves;
+    board.candidates().forEach([&](size_t cell) { moves.push_back(cell); });
+    auto prev = std::find(moves.begin(), moves.end(), previousBest);
+    if (prev != moves.end()) {
+      std::rotate(moves.begin(), prev, prev + 1);
+    }
+
+    bestScore = MIN;
+    Move best = moves.front();
+    for (Move cell : moves) {
+      board.make(cell);
+      int score = alphaBeta(w, board, depth - 1, std::max(alpha, bestScore), beta, 1);
+      board.unmake(cell);
+      if (aborted) {
+        break;
+      }
+      if (score > bestScore) {
+        best = cell;
+        bestScore = score;
+      }
+      if (bestScore >= beta) {
+        break;
       }
-      std::cout << std::endl;
     }
-    std::cout << LINE_SEP << std::endl;
+
+    return best;
+  }
+
+  int alphaBeta(Worker& w, Position& board, int depth, int alpha, int beta, size_t ply) {
+    if ((++w.nodes & 1023) == 0 && clock::now() >= deadline) {
+      aborted = true;
+    }
+    if (aborted.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+    if (board.isFinal()) {
+      return board.finalScore(computerCh);
+    }
+    if (depth <= 0) {
+      return board.evaluate(computerCh);
+    }
+
+    const bool maximizing = board.getToMove() == computerCh;
+    const int alphaOrig = alpha;
+    const int betaOrig = beta;
+
+    size_t sym;
+    const uint64_t key = board.canonicalHash(sym);
+    Move ttMove = TranspositionTable::NO_MOVE;
+    TranspositionTable::Entry e;
+    ++w.ttProbes;
+    if (tt.probe(key, e)) {
+      ++w.ttHits;
+      if (e.move != TranspositionTable::NO_MOVE && e.move < board.getMoveSpace()) {
+        ttMove = board.fromCanonical(e.move, sym);
+      }
+      if (e.depth >= depth) {
+        const int score = fromX(e.score);
+        const Bound bound = fromX(e.bound);
+        if (bound == Bound::EXACT) return score;
+        if (bound == Bound::LOWER) alpha = std::max(alpha, score);
+        if (bound == Bound::UPPER) beta = std::min(beta, score);
+        if (alpha >= beta) return score;
+      }
+    }
+
+    std::vector<Move>& moves = w.moveBuffers[ply];
+    orderMoves(w, board, ply, ttMove, moves);
+
+    int bestScore = maximizing ? MIN : MAX;
+    Move best = TranspositionTable::NO_MOVE;
+    for (Move cell : moves) {
+      board.make(cell);
+      const int score = alphaBeta(w, board, depth - 1, alpha, beta, ply + 1);
+      board.unmake(cell);
+      if (aborted.load(std::memory_order_relaxed)) {
+        return 0;
+      }
+
+      if (maximizing ? score > bestScore : score < bestScore) {
+        bestScore = score;
+        best = cell;
+      }
+      if (maximizing) alpha = std::max(alpha, bestScore);
+      else beta = std::min(beta, bestScore);
+
+      if (alpha >= beta) {
+        if (w.killers[ply][0] != cell) {
+          w.killers[ply][1] = w.killers[ply][0];
+          w.killers[ply][0] = cell;
+        }
+        w.history[cell] = std::min<uint64_t>(w.history[cell] + depth * depth, UINT32_MAX);
+        break;
+      }
+    }
+
+    Bound bound = Bound::EXACT;
+    if (bestScore <= alphaOrig) bound = Bound::UPPER;
+    else if (bestScore >= betaOrig) bound = Bound::LOWER;
+    const Move canonicalBest = best == TranspositionTable::NO_MOVE ? best : board.toCanonical(best, sym);
+    tt.store(key, fromX(bestScore), depth, fromX(bound), canonicalBest);
+
+    return bestScore;
+  }
+
+  void orderMoves(Worker& w, const Position& board, size_t ply, Move ttMove, std::vector<Move>& moves) {
+    moves.clear();
+    board.candidates().forEach([&](size_t cell) { moves.push_back(cell); });
+
+    w.ranks.resize(board.getMoveSpace());
+    for (Move cell : moves) {
+      uint64_t rank = (uint64_t)board.movePriority(cell) << 32 | w.history[cell];
+      if (cell == w.killers[ply][1]) rank = std::numeric_limits<uint64_t>::max() - 2;
+      if (cell == w.killers[ply][0]) rank = std::numeric_limits<uint64_t>::max() - 1;
+      if (cell == ttMove) rank = std::numeric_limits<uint64_t>::max();
+      w.ranks[cell] = rank;
+    }
+    std::stable_sort(moves.begin(), moves.end(), [&](Move a, Move b) { return w.ranks[a] > w.ranks[b]; });
+  }
+
+  // The table is shared between games where the computer may play either side,
+  // so scores are stored from X's point of view.
+  int fromX(int score) const {
+    return computerCh == X ? score : -score;
+  }
+
+  Bound fromX(Bound bound) const {
+    if (computerCh == X || bound == Bound::EXACT) return bound;
+    return bound == Bound::LOWER ? Bound::UPPER : Bound::LOWER;
+  }
+};
+
+
+// Monte Carlo tree search (UCT) for boards too large to search exhaustively. Every
+// iteration walks the tree by the UCB1 rule, expands the leaf, finishes the game with
+// uniformly random moves and credits the result to every node on the path.
+//
+// Parallelism is at the root: each thread grows its own tree in its own node arena
+// without any synchronisation, and the visit counts of the root moves are summed at
+// the end. The most visited move is played.
+template <typename Position>
+class MonteCarloSearch {
+private:
+  using Move = typename Position::Move;
+  using clock = std::chrono::steady_clock;
+
+  static constexpr double EXPLORATION = 1.4;
+  // Trees stop growing at this many nodes; later iterations only run playouts.
+  static constexpr size_t MAX_NODES = 1 << 22;
+
+  // Children of a node are allocated together, so a node refers to them by the index of
+  // the first one. Rewards are from the point of view of the player who made the move.
+  struct Node {
+    uint32_t firstChild = 0;
+    uint16_t childCount = 0;
+    Move move = 0;
+    char mover = EMPTY;
+    bool expanded = false;
+    uint32_t visits = 0;
+    double reward = 0;
+  };
+
+  struct Tree {
+    std::vector<Node> nodes;
+    uint64_t seed = 0;
+    size_t iterations = 0;
+  };
+
+  const std::chrono::duration<double> timeBudget;
+  const size_t iterationBudget;
+  const size_t threads;
+  std::vector<Tree> trees;
+
+public:
+  struct Result {
+    Move move;
+    double winRate;
+    size_t iterations;
+    double seconds;
+  };
+
+  // An iteration budget of 0 leaves only the time budget; otherwise it is split between
+  // the threads and the search stops at whichever runs out first.
+  MonteCarloSearch(double timeBudget = 1.0, size_t threads = 1, size_t iterationBudget = 0)
+    : timeBudget(timeBudget), iterationBudget(iterationBudget), threads(std::max<size_t>(threads, 1))
+  {}
+
+  Move bestMove(const Position& board) {
+    return analyze(board).move;
+  }
+
+  Result analyze(const Position& board) {
+    const auto start = clock::now();
+    const auto deadline = start + std::chrono::duration_cast<clock::duration>(timeBudget);
+    const size_t share = iterationBudget ? (iterationBudget + threads - 1) / threads : 0;
+
+    trees.assign(threads, Tree{});
+    std::vector<std::thread> helpers;
+    for (size_t id = 1; id < threads; ++id) {
+      helpers.emplace_back([this, id, board, deadline, share] { grow(trees[id], board, id, deadline, share); });
+    }
+    grow(trees[0], board, 0, deadline, share);
+    for (std::thread& helper : helpers) {
+      helper.join();
+    }
+
+    std::vector<uint64_t> visits(board.getMoveSpace(), 0);
+    std::vector<double> rewards(board.getMoveSpace(), 0);
+    size_t iterations = 0;
+    for (const Tree& tree : trees) {
+      iterations += tree.iterations;
+      const Node& root = tree.nodes[0];
+      for (size_t i = 0; i < root.childCount; ++i) {
+        const Node& child = tree.nodes[root.firstChild + i];
+        visits[child.move] += child.visits;
+        rewards[child.move] += child.reward;
+      }
+    }
+
+    Move best = TranspositionTable::NO_MOVE;
+    board.candidates().forEach([&](size_t move) {
+      if (best == TranspositionTable::NO_MOVE || visits[move] > visits[best]) best = move;
+    });
+    const std::chrono::duration<double> elapsed = clock::now() - start;
+    return {best, visits[best] ? rewards[best] / visits[best] : 0.5, iterations, elapsed.count()};
+  }
+
+private:
+  void grow(Tree& tree, Position board, size_t id, clock::time_point deadline, size_t share) {
+    tree.seed = 0x3C75 + id;
+    tree.nodes.reserve(1 << 16);
+    tree.nodes.push_back(Node{});
+
+    std::vector<uint32_t> path;
+    std::vector<Move> played;
+    while ((!share || tree.iterations < share) && clock::now() < deadline) {
+      iterate(tree, board, path, played);
+      ++tree.iterations;
+      if (tree.iterations == 1 && tree.nodes[0].childCount <= 1) {
+        break;
+      }
+    }
+  }
+
+  void iterate(Tree& tree, Position& board, std::vector<uint32_t>& path, std::vector<Move>& played) {
+    path.assign(1, 0);
+    played.clear();
+
+    uint32_t node = 0;
+    while (tree.nodes[node].expanded && !board.isFinal()) {
+      node = select(tree, node);
+      board.make(tree.nodes[node].move);
+      played.push_back(tree.nodes[node].move);
+      path.push_back(node);
+    }
+
+    if (!board.isFinal() && tree.nodes.size() < MAX_NODES) {
+      expand(tree, node, board);
+      const Node& leaf = tree.nodes[node];
+      node = leaf.firstChild + splitmix64(tree.seed) % leaf.childCount;
+      board.make(tree.nodes[node].move);
+      played.push_back(tree.nodes[node].move);
+      path.push_back(node);
+    }
+
+    Bitboard moves = board.candidates();
+    while (!board.isFinal()) {
+      const Move move = moves.nth(splitmix64(tree.seed) % moves.count());
+      board.make(move);
+      board.updateCandidates(moves, move);
+      played.push_back(move);
+    }
+
+    const int score = board.finalScore(X);
+    const double xReward = score > 0 ? 1.0 : score < 0 ? 0.0 : 0.5;
+    for (uint32_t n : path) {
+      Node& visited = tree.nodes[n];
+      ++visited.visits;
+      visited.reward += visited.mover == X ? xReward : 1.0 - xReward;
+    }
+
+    for (auto it = played.rbegin(); it != played.rend(); ++it) {
+      board.unmake(*it);
+    }
+  }
+
+  // UCB1; children that were never visited come first.
+  uint32_t select(const Tree& tree, uint32_t node) const {
+    const Node& parent = tree.nodes[node];
+    const double logVisits = std::log((double)parent.visits);
+    uint32_t best = parent.firstChild;
+    double bestValue = -1;
+    for (uint32_t child = parent.firstChild; child < parent.firstChild + parent.childCount; ++child) {
+      const Node& c = tree.nodes[child];
+      if (c.visits == 0) {
+        return child;
+      }
+      const double value = c.reward / c.visits + EXPLORATION * std::sqrt(logVisits / c.visits);
+      if (value > bestValue) {
+        bestValue = value;
+        best = child;
+      }
+    }
+    return best;
   }
 
+  void expand(Tree& tree, uint32_t node, const Position& board) {
+    const uint32_t first = tree.nodes.size();
+    const char mover = board.getToMove();
+    board.candidates().forEach([&](size_t move) {
+      Node child;
+      child.move = move;
+      child.mover = mover;
+      tree.nodes.push_back(child);
+    });
+    Node& parent = tree.nodes[node];
+    parent.firstChild = first;
+    parent.childCount = tree.nodes.size() - first;
+    parent.expanded = true;
+  }
 };
 
+// How the computer picks its moves.
+struct EngineOptions {
+  double timeBudget = 1.0;
+  size_t threads = 1;
+  bool monteCarlo = false;
+  size_t iterations = 0;
+};
 
+template <typename Position>
 class Game {
 private:
-  Board board;
+  Position board;
+  Search<Position> search;
+  MonteCarloSearch<Position> monteCarlo;
+  const bool useMonteCarlo;
+  const Tablebase* tablebase;
   bool isComputerFirst;
   char computerCh;
   char playerCh;
 
 public:
-  Game(bool isComputerFirst) :
+  Game(bool isComputerFirst, TranspositionTable& tt, const Position& board, const EngineOptions& engine,
+       const Tablebase* tablebase = nullptr) :
+    board(board),
+    search(tt, isComputerFirst ? X : O, engine.timeBudget, engine.threads),
+    monteCarlo(engine.timeBudget, engine.threads, engine.iterations),
+    useMonteCarlo(engine.monteCarlo),
+    tablebase(tablebase),
     isComputerFirst(isComputerFirst),
     computerCh(isComputerFirst ? X : O),
     playerCh(isComputerFirst ? O : X)
@@ -101,26 +1719,27 @@ public:
   void play() {
     board.print();
 
-    bool isComputersTurn = isComputerFirst;
+    bool lastWasComputer = false;
     while (!board.isFinal()) {
-      if (isComputersTurn) {
+      lastWasComputer = board.getToMove() == computerCh;
+      if (lastWasComputer) {
         computersTurn();
         board.print();
       } else {
         playersTurn();
       }
-      isComputersTurn = !isComputersTurn;
     }
 
-    if (isComputersTurn) {
+    if (!lastWasComputer) {
       board.print();
     }
 
-    if (board.isWinner(playerCh)) {
+    const int score = board.finalScore(computerCh);
+    if (score < 0) {
       std::cout << "Player wins!" << std::endl;
-    } else if (board.isWinner(computerCh)) {
+    } else if (score > 0) {
       std::cout << "Computer wins!" << std::endl;
-    } else if (board.isFilled()) {
+    } else {
       std::cout << "Draw!" << std::endl;
     }
   }
@@ -128,123 +1747,259 @@ public:
 private:
   void playersTurn() {
     while (true) {
-      std::cout << "Your [" << playerCh << "] move ― row[1-3] col[1-3]: ";
+      std::cout << board.movePrompt();
 
       std::string input;
       std::getline(std::cin, input);
       std::stringstream ss(input);
 
-      size_t row, col;
-      ss >> row >> col;
-      if (!ss) {
+      typename Position::Move move;
+      if (!board.readMove(ss, move)) {
         std::cout << "Invalid input!" << std::endl;
         continue;
       }
 
-      if (!board.move(playerCh, row - 1, col - 1)) {
+      if (!board.isLegal(move)) {
         std::cout << "Invalid move!" << std::endl;
         continue;
       }
 
+      board.make(move);
       break;
     }
     std::cout << LINE_SEP << std::endl;
   }
 
+  // Positions covered by the tablebase are answered from it without searching.
   void computersTurn() {
-    board = minimaxAlphaBeta(board);
-  }
-
-  Board minimaxAlphaBeta(const Board& board) const {
-    int bestScore = MIN;
-    Board best;
-
-    for (const Board& succ : board.successors(computerCh)) {
-      int score = min(succ, MIN, MAX);
-      if (score > bestScore) {
-        best = succ;
-        bestScore = score;
-      }
+    typename Position::Move move;
+    if (!tablebase || !tablebase->lookup(board, move)) {
+      move = useMonteCarlo ? monteCarlo.bestMove(board) : search.bestMove(board);
     }
-
-    return best;
+    board.make(move);
   }
+};
 
-  int min(const Board& board, int alpha, int beta) const {
-    if (board.isFinal()) {
-      return finalScore(board);
-    }
-
-    int bestScore = MAX;
-    for (const Board& succ : board.successors(playerCh)) {
-      bestScore = std::min(bestScore, max(succ, alpha, beta));
+template <typename Position>
+void playGames(const Position& empty, const EngineOptions& engine, const std::string& tablebasePath,
+               const std::function<bool()>& askComputerFirst) {
+  TranspositionTable tt(64 << 20);
+  std::unique_ptr<Tablebase> tablebase;
+  if (!tablebasePath.empty()) {
+    tablebase = std::make_unique<Tablebase>(tablebasePath, empty);
+  }
+  while (true) {
+    Game<Position>(askComputerFirst(), tt, empty, engine, tablebase.get()).play();
 
-      if (bestScore <= alpha) {
-        return bestScore;
-      }
+    std::string input;
+    std::cout << "Do you want to play again? [Y/n]: ";
+    std::getline(std::cin, input);
 
-      beta = std::min(beta, bestScore);
+    if (input == "n") {
+      break;
     }
-
-    return bestScore;
   }
+}
 
-  int max(const Board& board, int alpha, int beta) const {
-    if (board.isFinal()) {
-      return finalScore(board);
-    }
+// Headless search of any position for the side to move, without prompts or printing.
+template <typename Position>
+typename Search<Position>::Result analyze(const Position& board, TranspositionTable& tt, double timeBudget,
+                                          size_t threads = 1) {
+  return Search<Position>(tt, board.getToMove(), timeBudget, threads).analyze(board);
+}
 
-    int bestScore = MIN;
-    for (const Board& succ : board.successors(computerCh)) {
-      bestScore = std::max(bestScore, min(succ, alpha, beta));
+// Engine against engine on `threads` game threads, each with its own table and a
+// single-threaded search per move. The first openingPlies moves of every game are
+// random, seeded by the game number, so games differ and runs are repeatable.
+// Writes one CSV row per searched move and a summary to stderr.
+template <typename Position>
+void selfPlay(const Position& empty, size_t games, double timeBudget, size_t threads, size_t openingPlies,
+              std::ostream& csv) {
+  csv << "game,ply,player,move,score,depth,nodes,tt_hit_rate,seconds" << std::endl;
 
-      if (bestScore >= beta) {
-        return bestScore;
+  std::atomic<size_t> nextGame = 0;
+  std::array<std::atomic<size_t>, 3> outcomes{};  // X wins, O wins, draws
+  std::atomic<size_t> totalNodes = 0;
+  std::atomic<uint64_t> totalMicros = 0;
+  std::mutex csvLock;
+
+  const auto play = [&] {
+    TranspositionTable tt(16 << 20);
+    for (size_t game; (game = nextGame++) < games;) {
+      Position board = empty;
+      Search<Position> xSearch(tt, X, timeBudget), oSearch(tt, O, timeBudget);
+      uint64_t seed = game;
+      std::stringstream rows;
+      for (size_t ply = 0; !board.isFinal(); ++ply) {
+        typename Position::Move move;
+        if (ply < openingPlies) {
+          std::vector<typename Position::Move> moves;
+          board.candidates().forEach([&](size_t m) { moves.push_back(m); });
+          move = moves[splitmix64(seed) % moves.size()];
+        } else {
+          const char side = board.getToMove();
+          const auto result = (side == X ? xSearch : oSearch).analyze(board);
+          move = result.move;
+          rows << game << ',' << ply << ',' << side << ',' << move << ',' << result.score << ','
+               << result.depth << ',' << result.nodes << ',' << result.ttHitRate << ',' << result.seconds
+               << '\n';
+          totalNodes += result.nodes;
+          totalMicros += (uint64_t)(result.seconds * 1e6);
+        }
+        board.make(move);
       }
 
-      alpha = std::max(alpha, bestScore);
+      const int score = board.finalScore(X);
+      ++outcomes[score > 0 ? 0 : score < 0 ? 1 : 2];
+      std::lock_guard<std::mutex> guard(csvLock);
+      csv << rows.str() << std::flush;
     }
+  };
 
-    return bestScore;
+  std::vector<std::thread> players;
+  for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+    players.emplace_back(play);
   }
-
-  int finalScore(const Board& board) const {
-    if (board.isWinner(computerCh))
-      return 1 + board.getEmptyCount();
-    if (board.isWinner(playerCh))
-      return -1 - board.getEmptyCount();
-    return 0;
+  for (std::thread& player : players) {
+    player.join();
   }
 
-};
-
-int Board::winnings[8][3][2] {
-  {{0, 0}, {0, 1}, {0, 2}},
-  {{1, 0}, {1, 1}, {1, 2}},
-  {{2, 0}, {2, 1}, {2, 2}},
-
-  {{0, 0}, {1, 0}, {2, 0}},
-  {{0, 1}, {1, 1}, {2, 1}},
-  {{0, 2}, {1, 2}, {2, 2}},
-
-  {{0, 0}, {1, 1}, {2, 2}},
-  {{0, 2}, {1, 1}, {2, 0}},
-};
+  std::cerr << games << " games: X won " << outcomes[0] << ", O won " << outcomes[1] << ", drawn "
+            << outcomes[2] << "; " << (size_t)(totalNodes * 1e6 / std::max(totalMicros.load(), uint64_t(1)))
+            << " nodes/s per search thread" << std::endl;
+}
 
-int main() {
-  while (true) {
-    std::string input;
+// Searches the first move of an empty board with 1, 2, 4, ... maxThreads threads and
+// prints the node rate of each as CSV. Every run gets a fresh table.
+template <typename Position>
+void benchmarkThreads(const Position& empty, double timeBudget, size_t maxThreads) {
+  std::cout << "threads,nodes,seconds,nodes_per_sec,depth,tt_hit_rate" << std::endl;
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    TranspositionTable tt(64 << 20);
+    const auto result = analyze(empty, tt, timeBudget, threads);
+    std::cout << threads << ',' << result.nodes << ',' << result.seconds << ','
+              << (size_t)(result.nodes / result.seconds) << ',' << result.depth << ',' << result.ttHitRate
+              << std::endl;
+  }
+}
 
-    std::cout << "Do you want to go first? [Y/n]: ";
-    std::getline(std::cin, input);
+template <typename Position>
+void generateTablebase(const Position& empty, const std::string& path) {
+  auto start = std::chrono::steady_clock::now();
+  const std::vector<Tablebase::Entry> table = Tablebase::generate(empty);
+  Tablebase::write(path, empty, table);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-    Game(input == "n").play();
+  const Tablebase::Entry& root = table[empty.tablebaseIndex()];
+  std::cout << table.size() << " positions solved in " << elapsed.count() << "s, first player value "
+            << (int)root.value << std::endl;
+}
 
-    std::cout << "Do you want to play again? [Y/n]: ";
-    std::getline(std::cin, input);
+// Usage: main [rows cols k] [-time seconds] [-threads n] [-mcts [iterations]] [-tablebase file]
+//        main dots [rows cols] [-time seconds] [-threads n] [-mcts [iterations]] [-tablebase file]
+//        main [rows cols k | dots rows cols] -bench max-threads [-time seconds]
+//        main [rows cols k | dots rows cols] -generate file
+//        main [rows cols k | dots rows cols] -selfplay games [-threads n] [-time seconds]
+//             [-opening plies] [-csv file]
+int main(int argc, char* argv[]) {
+  size_t rows = 3, cols = 3, k = 3;
+  EngineOptions engine;
+  size_t benchThreads = 0;
+  std::string tablebasePath;
+  std::string generatePath;
+  size_t selfPlayGames = 0;
+  size_t openingPlies = 2;
+  std::string csvPath;
+  bool dots = false;
+  std::vector<std::string> args(argv + 1, argv + argc);
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "-time" && i + 1 < args.size()) {
+      engine.timeBudget = std::stod(args[++i]);
+    } else if (args[i] == "-threads" && i + 1 < args.size()) {
+      engine.threads = std::stoul(args[++i]);
+    } else if (args[i] == "-mcts") {
+      engine.monteCarlo = true;
+      if (i + 1 < args.size() && std::isdigit((unsigned char)args[i + 1][0])) {
+        engine.iterations = std::stoul(args[++i]);
+      }
+    } else if (args[i] == "-bench" && i + 1 < args.size()) {
+      benchThreads = std::stoul(args[++i]);
+    } else if (args[i] == "-tablebase" && i + 1 < args.size()) {
+      tablebasePath = args[++i];
+    } else if (args[i] == "-generate" && i + 1 < args.size()) {
+      generatePath = args[++i];
+    } else if (args[i] == "-selfplay" && i + 1 < args.size()) {
+      selfPlayGames = std::stoul(args[++i]);
+    } else if (args[i] == "-opening" && i + 1 < args.size()) {
+      openingPlies = std::stoul(args[++i]);
+    } else if (args[i] == "-csv" && i + 1 < args.size()) {
+      csvPath = args[++i];
+    } else if (args[i] == "dots") {
+      dots = true;
+    } else if (dots && i + 1 < args.size()) {
+      rows = std::stoul(args[i]);
+      cols = std::stoul(args[++i]);
+    } else if (i + 2 < args.size()) {
+      rows = std::stoul(args[i]);
+      cols = std::stoul(args[i + 1]);
+      k = std::stoul(args[i + 2]);
+      i += 2;
+    }
+  }
 
-    if (input == "n") {
-      break;
+  try {
+    std::string input;
+    if (!generatePath.empty()) {
+      if (dots) {
+        generateTablebase(DotsBoard(rows, cols), generatePath);
+      } else {
+        generateTablebase(Board(rows, cols, k), generatePath);
+      }
+    } else if (selfPlayGames) {
+      std::ofstream file;
+      if (!csvPath.empty()) {
+        file.open(csvPath);
+        if (!file) {
+          throw std::runtime_error("Cannot write " + csvPath + ".");
+        }
+      }
+      std::ostream& csv = csvPath.empty() ? std::cout : file;
+      if (dots) {
+        selfPlay(DotsBoard(rows, cols), selfPlayGames, engine.timeBudget, engine.threads, openingPlies, csv);
+      } else {
+        selfPlay(Board(rows, cols, k), selfPlayGames, engine.timeBudget, engine.threads, openingPlies, csv);
+      }
+    } else if (benchThreads) {
+      if (dots) {
+        benchmarkThreads(DotsBoard(rows, cols), engine.timeBudget, benchThreads);
+      } else {
+        benchmarkThreads(Board(rows, cols, k), engine.timeBudget, benchThreads);
+      }
+    } else if (dots) {
+      std::cout << "Enter N, M:" << std::endl;
+      std::getline(std::cin, input);
+      std::stringstream ss(input);
+      size_t n, m;
+      if (ss >> n >> m) {
+        rows = n;
+        cols = m;
+      }
+      playGames(DotsBoard(rows, cols), engine, tablebasePath, [&] {
+        std::cout << "Computer(1) or Player(2) is first?" << std::endl;
+        std::getline(std::cin, input);
+        return input == "1";
+      });
+    } else {
+      playGames(Board(rows, cols, k), engine, tablebasePath, [&] {
+        std::cout << "Do you want to go first? [Y/n]: ";
+        std::getline(std::cin, input);
+        return input == "n";
+      });
     }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
   }
+
+  return 0;
 }
@@ -1,46 +1,279 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <numbers>
 #include <numeric>
 #include <random>
-#include <sstream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 std::random_device rndd;
 std::default_random_engine rnde(rndd());
 
 
-using CSVLine = std::vector<std::string>;
-using CSV = std::vector<CSVLine>;
+// Read-only memory mapping of a whole file. An empty file is open but maps nothing.
+class MappedFile {
+private:
+  const char* data = nullptr;
+  size_t length = 0;
+  bool opened = false;
+
+public:
+  MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+      opened = true;
+      if (st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          data = static_cast<const char*>(p);
+          length = st.st_size;
+        } else {
+          opened = false;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data) {
+      munmap(const_cast<char*>(data), length);
+    }
+  }
+
+  bool isOpen() const {
+    return opened;
+  }
+
+  const char* begin() const {
+    return data;
+  }
+
+  size_t size() const {
+    return length;
+  }
+};
+
+
+using CSVLine = std::span<const std::string_view>;
+
+// Rows of a CSV file as views into its memory mapping, so reading allocates per row
+// only for the index and never per field. Quoted fields that contain doubled quotes are
+// the only ones copied, unescaped, into storage owned by the table.
+class CSV {
+public:
+  class Iterator {
+  private:
+    const CSV* csv;
+    size_t row;
+
+  public:
+    Iterator(const CSV* csv, size_t row) : csv(csv), row(row) {}
+    CSVLine operator*() const { return (*csv)[row]; }
+    Iterator& operator++() { ++row; return *this; }
+    bool operator!=(const Iterator& other) const { return row != other.row; }
+  };
+
+private:
+  std::unique_ptr<MappedFile> file;
+  std::vector<std::string_view> fields;
+  // Fields of row r are fields[rowStarts[r]] up to fields[rowStarts[r + 1]].
+  std::vector<size_t> rowStarts{0};
+  // One store per parsing chunk, never resized, so views into it stay valid.
+  std::vector<std::deque<std::string>> unescaped;
+
+  friend class CSVReader;
+
+public:
+  size_t size() const {
+    return rowStarts.size() - 1;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  CSVLine operator[](size_t row) const {
+    return CSVLine(fields.data() + rowStarts[row], rowStarts[row + 1] - rowStarts[row]);
+  }
+
+  CSVLine front() const {
+    return (*this)[0];
+  }
 
+  Iterator begin() const {
+    return Iterator(this, 0);
+  }
 
+  Iterator end() const {
+    return Iterator(this, size());
+  }
+};
+
+
+// Single-pass tokenizer over a memory-mapped file. Fields are separated by commas and
+// may be enclosed in double quotes, with "" for a quote inside; quoted fields can span
+// lines. Trailing carriage returns and blank lines are dropped.
+//
+// Large files are parsed by several threads. The file is cut into equal chunks, a first
+// parallel pass counts the quotes in each so every cut knows whether it falls inside a
+// quoted field, and each cut then moves forward to the next line break outside quotes.
 class CSVReader {
 public:
-  static CSV readFile(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
+  static CSV readFile(const std::string& filePath, size_t threads = std::thread::hardware_concurrency()) {
+    CSV csv;
+    csv.file = std::make_unique<MappedFile>(filePath);
+    if (!csv.file->isOpen()) {
       throw std::runtime_error("Failed to open file.");
     }
 
-    CSV lines;
-    std::string line;
-    while (std::getline(file, line)) {
-      std::istringstream iss(line);
-      CSVLine cols;
-      std::string token;
+    const char* begin = csv.file->begin();
+    const char* end = begin + csv.file->size();
+    const size_t minChunk = 1 << 20;
+    const size_t chunks = std::clamp<size_t>(csv.file->size() / minChunk, 1, std::max<size_t>(threads, 1));
+
+    std::vector<const char*> cuts(chunks + 1, end);
+    for (size_t i = 0; i < chunks; i++) {
+      cuts[i] = begin + csv.file->size() / chunks * i;
+    }
+    if (chunks > 1) {
+      std::vector<size_t> quotes(chunks);
+      parallel(chunks, [&](size_t i) { quotes[i] = std::count(cuts[i], cuts[i + 1], '"'); });
+      size_t before = 0;
+      for (size_t i = 0; i < chunks; i++) {
+        cuts[i] = nextRow(cuts[i], end, before % 2 == 1, i == 0);
+        before += quotes[i];
+      }
+    }
+
+    std::vector<CSV> parts(chunks);
+    csv.unescaped.resize(chunks);
+    parallel(chunks, [&](size_t i) { parseChunk(cuts[i], std::max(cuts[i], cuts[i + 1]), parts[i], csv.unescaped[i]); });
 
-      while (std::getline(iss, token, ',')) {
-        cols.push_back(token);
+    size_t fieldCount = 0;
+    for (const CSV& part : parts) fieldCount += part.fields.size();
+    csv.fields.reserve(fieldCount);
+    for (const CSV& part : parts) {
+      const size_t offset = csv.fields.size();
+      csv.fields.insert(csv.fields.end(), part.fields.begin(), part.fields.end());
+      for (size_t r = 1; r < part.rowStarts.size(); r++) {
+        csv.rowStarts.push_back(offset + part.rowStarts[r]);
       }
+    }
+    return csv;
+  }
+
+  // Splits one line held by the caller; unescaped quoted fields are kept in storage.
+  static void splitLine(std::string_view line, std::vector<std::string_view>& fields, std::deque<std::string>& storage) {
+    fields.clear();
+    if (!line.empty() && line != "\r") {
+      parseRow(line.data(), line.data() + line.size(), fields, storage);
+    }
+  }
+
+private:
+  template <typename F>
+  static void parallel(size_t count, F f) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+      workers.emplace_back(f, i);
+    }
+    f(0);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Start of the first row at or after p, given whether p is inside a quoted field.
+  static const char* nextRow(const char* p, const char* end, bool quoted, bool atStart) {
+    if (atStart) {
+      return p;
+    }
+    for (; p < end; ++p) {
+      if (*p == '"') quoted = !quoted;
+      else if (*p == '\n' && !quoted) return p + 1;
+    }
+    return end;
+  }
 
-      lines.push_back(cols);
+  static void parseChunk(const char* p, const char* end, CSV& part, std::deque<std::string>& storage) {
+    while (p < end) {
+      if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+        p += *p == '\n' ? 1 : 2;
+        continue;
+      }
+      p = parseRow(p, end, part.fields, storage);
+      part.rowStarts.push_back(part.fields.size());
     }
-    file.close();
+  }
 
-    return lines;
+  // Appends the fields of the row starting at p and returns the start of the next row.
+  static const char* parseRow(const char* p, const char* end, std::vector<std::string_view>& fields,
+                              std::deque<std::string>& storage) {
+    while (true) {
+      std::string_view field;
+      if (p < end && *p == '"') {
+        const char* start = ++p;
+        bool escaped = false;
+        while (p < end && (*p != '"' || (p + 1 < end && p[1] == '"'))) {
+          if (*p == '"') {
+            escaped = true;
+            ++p;
+          }
+          ++p;
+        }
+        field = std::string_view(start, p - start);
+        if (escaped) {
+          std::string& copy = storage.emplace_back();
+          for (size_t i = 0; i < field.size(); i++) {
+            copy += field[i];
+            if (field[i] == '"') i++;
+          }
+          field = copy;
+        }
+        while (p < end && *p != ',' && *p != '\n') ++p;
+      } else {
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '\n') ++p;
+        const char* stop = p > start && p[-1] == '\r' ? p - 1 : p;
+        field = std::string_view(start, stop - start);
+      }
+      fields.push_back(field);
+      if (p >= end) {
+        return end;
+      }
+      if (*p++ == '\n') {
+        return p;
+      }
+    }
   }
 };
 
@@ -91,28 +324,40 @@ public:
     return dataset;
   }
 
-private:
-  static Party parseParty(const std::string& str) {
+  // A single row with "?" kept as its own value, as in mode 0.
+  static Person parseRow(const CSVLine& line) {
+    if (line.empty()) {
+      throw std::invalid_argument("Empty row.");
+    }
+    return Person(parseParty(line[0]), parseAttributes(line));
+  }
+
+  static Party parseParty(const std::string_view str) {
     if (str == "democrat") return Party::D;
     if (str == "republican") return Party::R;
     throw std::invalid_argument("Unknown value.");
   }
 
-  static Attribute parseAttribute(const std::string& str) {
-    if (str == "y") return Attribute::YAY;
-    if (str == "n") return Attribute::NAY;
-    if (str == "?") return Attribute::UNK;
-    throw std::invalid_argument("Unknown value.");
+  static std::string formatParty(const Party party) {
+    return party == Party::D ? "democrat" : "republican";
   }
 
-  static std::vector<Attribute> parseAttributes(const CSVLine& line) {
+  static std::vector<Attribute> parseAttributes(const CSVLine& line, const size_t first = 1) {
     std::vector<Attribute> attributes;
-    for (size_t i = 1; i < line.size(); i++) {
+    for (size_t i = first; i < line.size(); i++) {
       attributes.push_back(parseAttribute(line[i]));
     }
     return attributes;
   }
 
+private:
+  static Attribute parseAttribute(const std::string_view str) {
+    if (str == "y") return Attribute::YAY;
+    if (str == "n") return Attribute::NAY;
+    if (str == "?") return Attribute::UNK;
+    throw std::invalid_argument("Unknown value.");
+  }
+
   static void readPartyVotes(const std::vector<Attribute>& attributes, std::vector<int>& partyVotes) {
     if (attributes.size() != partyVotes.size()) {
       if (partyVotes.size() != 0) {
@@ -142,159 +387,1426 @@ private:
 };
 
 
+// Column-wise copy of a dataset with one bitplane per attribute value: bit r of plane
+// (attribute, value) is set when row r has that value. Parties are one more plane with
+// the bit set for republicans. Bits past the last row are always zero.
+struct ColumnarDataset {
+  static constexpr size_t VALUES = 3;
+
+  size_t rows = 0;
+  size_t words = 0;
+  size_t attributeCount = 0;
+  std::vector<uint64_t> republicans;
+  // planes[(attribute * VALUES + value) * words + word]
+  std::vector<uint64_t> planes;
+
+  static ColumnarDataset pack(const std::vector<Person>& dataset) {
+    ColumnarDataset c;
+    c.rows = dataset.size();
+    c.words = (c.rows + 63) / 64;
+    c.attributeCount = dataset.empty() ? 0 : dataset.front().attributes.size();
+    c.republicans.assign(c.words, 0);
+    c.planes.assign(c.attributeCount * VALUES * c.words, 0);
+
+    for (size_t row = 0; row < c.rows; row++) {
+      const uint64_t bit = uint64_t(1) << (row % 64);
+      const Person& person = dataset[row];
+      if (person.attributes.size() != c.attributeCount) {
+        throw std::runtime_error("Inconsistent attribute count.");
+      }
+      if (person.party == Party::R) {
+        c.republicans[row / 64] |= bit;
+      }
+      for (size_t i = 0; i < c.attributeCount; i++) {
+        c.planes[c.plane(i, person.attributes[i]) + row / 64] |= bit;
+      }
+    }
+    return c;
+  }
+
+  size_t plane(size_t attribute, Attribute value) const {
+    return (attribute * VALUES + (size_t)value) * words;
+  }
+
+  Party party(size_t row) const {
+    return republicans[row / 64] >> (row % 64) & 1 ? Party::R : Party::D;
+  }
+
+  // The party as a class id, for the evaluation.
+  size_t label(size_t row) const {
+    return (size_t)party(row);
+  }
+
+  size_t classes() const {
+    return 2;
+  }
+};
+
+
+// Per-party counts of every attribute value over a set of rows. Counts are additive, so
+// the counts of any subset can be taken away from those of the whole set.
+struct NaiveBayesCounts {
+  static constexpr size_t PARTIES = 2;
+  static constexpr size_t VALUES = ColumnarDataset::VALUES;
+
+  size_t rows = 0;
+  size_t attributeCount = 0;
+  std::array<size_t, PARTIES> partyCounts{};
+  // counts[(party * attributeCount + attribute) * VALUES + value]
+  std::vector<size_t> counts;
+
+  // Counts rows [begin, end) of a packed dataset with popcounts of its bitplanes.
+  static NaiveBayesCounts count(const ColumnarDataset& data, size_t begin, size_t end) {
+    NaiveBayesCounts c;
+    c.rows = end - begin;
+    c.attributeCount = data.attributeCount;
+    c.counts.assign(PARTIES * c.attributeCount * VALUES, 0);
+    if (begin >= end) {
+      return c;
+    }
+
+    const size_t first = begin / 64, last = (end - 1) / 64;
+    const auto rowMask = [&](size_t w) {
+      uint64_t mask = ~uint64_t(0);
+      if (w == first) mask &= ~uint64_t(0) << (begin % 64);
+      if (w == last && end % 64) mask &= ~uint64_t(0) >> (64 - end % 64);
+      return mask;
+    };
+
+    for (size_t w = first; w <= last; w++) {
+      c.partyCounts[(size_t)Party::R] += std::popcount(data.republicans[w] & rowMask(w));
+    }
+    c.partyCounts[(size_t)Party::D] = c.rows - c.partyCounts[(size_t)Party::R];
+
+    for (size_t i = 0; i < c.attributeCount; i++) {
+      for (size_t v = 0; v < VALUES; v++) {
+        const uint64_t* plane = &data.planes[data.plane(i, (Attribute)v)];
+        size_t total = 0, republicans = 0;
+        for (size_t w = first; w <= last; w++) {
+          const uint64_t bits = plane[w] & rowMask(w);
+          total += std::popcount(bits);
+          republicans += std::popcount(bits & data.republicans[w]);
+        }
+        c.at((size_t)Party::R, i, (Attribute)v) = republicans;
+        c.at((size_t)Party::D, i, (Attribute)v) = total - republicans;
+      }
+    }
+    return c;
+  }
+
+  static NaiveBayesCounts count(const ColumnarDataset& data) {
+    return count(data, 0, data.rows);
+  }
+
+  // Counts the rows at the given indices, each as many times as it is listed. Every pass
+  // sets one bit per distinct row still pending and counts those bits; rows listed again
+  // wait for the next pass.
+  static NaiveBayesCounts count(const ColumnarDataset& data, std::span<const size_t> indices) {
+    NaiveBayesCounts c = count(data, 0, 0);
+    std::vector<size_t> pending(indices.begin(), indices.end()), repeated;
+    std::vector<uint64_t> mask(data.words);
+    while (!pending.empty()) {
+      std::fill(mask.begin(), mask.end(), 0);
+      repeated.clear();
+      for (const size_t row : pending) {
+        const uint64_t bit = uint64_t(1) << (row % 64);
+        if (mask[row / 64] & bit) {
+          repeated.push_back(row);
+        } else {
+          mask[row / 64] |= bit;
+        }
+      }
+      c += countWords(data, mask);
+      pending.swap(repeated);
+    }
+    return c;
+  }
+
+  void add(const Person& person) {
+    if (rows == 0 && counts.empty()) {
+      attributeCount = person.attributes.size();
+      counts.assign(PARTIES * attributeCount * VALUES, 0);
+    }
+    if (person.attributes.size() != attributeCount) {
+      throw std::runtime_error("Inconsistent attribute count.");
+    }
+    rows++;
+    partyCounts[(size_t)person.party]++;
+    for (size_t i = 0; i < attributeCount; i++) {
+      at((size_t)person.party, i, person.attributes[i])++;
+    }
+  }
+
+  NaiveBayesCounts& operator+=(const NaiveBayesCounts& other) {
+    rows += other.rows;
+    for (size_t party = 0; party < PARTIES; party++) {
+      partyCounts[party] += other.partyCounts[party];
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+      counts[i] += other.counts[i];
+    }
+    return *this;
+  }
+
+  NaiveBayesCounts& operator-=(const NaiveBayesCounts& other) {
+    rows -= other.rows;
+    for (size_t party = 0; party < PARTIES; party++) {
+      partyCounts[party] -= other.partyCounts[party];
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+      counts[i] -= other.counts[i];
+    }
+    return *this;
+  }
+
+  NaiveBayesCounts operator-(const NaiveBayesCounts& other) const {
+    NaiveBayesCounts result = *this;
+    return result -= other;
+  }
+
+  size_t& at(size_t party, size_t attribute, Attribute value) {
+    return counts[(party * attributeCount + attribute) * VALUES + (size_t)value];
+  }
+
+private:
+  // Counts the rows whose bits are set in mask, one word per 64 rows of data.
+  static NaiveBayesCounts countWords(const ColumnarDataset& data, const std::vector<uint64_t>& mask) {
+    NaiveBayesCounts c = count(data, 0, 0);
+    for (size_t w = 0; w < data.words; w++) {
+      c.rows += std::popcount(mask[w]);
+      c.partyCounts[(size_t)Party::R] += std::popcount(data.republicans[w] & mask[w]);
+    }
+    c.partyCounts[(size_t)Party::D] = c.rows - c.partyCounts[(size_t)Party::R];
+
+    for (size_t i = 0; i < c.attributeCount; i++) {
+      for (size_t v = 0; v < VALUES; v++) {
+        const uint64_t* plane = &data.planes[data.plane(i, (Attribute)v)];
+        size_t total = 0, republicans = 0;
+        for (size_t w = 0; w < data.words; w++) {
+          const uint64_t bits = plane[w] & mask[w];
+          total += std::popcount(bits);
+          republicans += std::popcount(bits & data.republicans[w]);
+        }
+        c.at((size_t)Party::R, i, (Attribute)v) = republicans;
+        c.at((size_t)Party::D, i, (Attribute)v) = total - republicans;
+      }
+    }
+    return c;
+  }
+};
+
+
+// Log-probabilities are computed once by train() into dense tables, so scoring a row is
+// one table lookup per attribute and class. Batch scoring works on the bitplanes of a
+// ColumnarDataset, 64 rows per machine word.
+//
+// save() writes the tables after a small header; load() maps such a file and scores
+// straight from the mapping without parsing or copying it.
 class NaiveBayesClassifier {
+public:
+  using Data = ColumnarDataset;
+  using Counts = NaiveBayesCounts;
+
+  static constexpr size_t PARTIES = NaiveBayesCounts::PARTIES;
+  static constexpr size_t VALUES = NaiveBayesCounts::VALUES;
+
 private:
-  const std::vector<Person> dataset;
-  std::unordered_map<Party, std::unordered_map<Attribute, std::vector<size_t>>> map;
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t parties;
+    uint32_t values;
+    uint64_t attributeCount;
+    uint64_t reserved;
+  };
+
+  static constexpr char MAGIC[4] = {'H', 'W', '5', 'N'};
+  static constexpr uint32_t VERSION = 1;
+
+  size_t attributeCount = 0;
+  // The log-priors of both parties followed by the log-likelihoods, indexed
+  // [(party * attributeCount + attribute) * VALUES + value].
+  std::vector<double> tables;
+  std::shared_ptr<const MappedFile> mapping;
 
 public:
-  NaiveBayesClassifier(const std::vector<Person>& dataset) :
-    dataset(dataset)
-  {}
+  void train(const ColumnarDataset& dataset) {
+    train(NaiveBayesCounts::count(dataset));
+  }
 
-  void train() {
-    map.clear();
+  void train(const NaiveBayesCounts& counts) {
+    const int lambda = 1;
+    const int k = 2;
 
-    for (const Person& person : dataset) {
-      auto& attrMap = map[person.party];
-      for (size_t i = 0; i < person.attributes.size(); i++) {
-        attrMap.try_emplace(person.attributes[i], person.attributes.size(), 0);
-        attrMap[person.attributes[i]][i]++;
+    attributeCount = counts.attributeCount;
+    mapping.reset();
+    tables.assign(PARTIES + counts.counts.size(), 0.0);
+    double* logLikelihood = tables.data() + PARTIES;
+    for (size_t party = 0; party < PARTIES; party++) {
+      const double denominator = std::log((double)(counts.partyCounts[party] + (k * lambda)));
+      for (size_t i = 0; i < attributeCount * VALUES; i++) {
+        const size_t cell = party * attributeCount * VALUES + i;
+        logLikelihood[cell] = std::log((double)(counts.counts[cell] + lambda)) - denominator;
       }
+      tables[party] = std::log((double)(counts.partyCounts[party] + lambda) / (counts.rows + (k * lambda)));
     }
   }
 
+  void save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    const Header header = {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, PARTIES, VALUES, attributeCount, 0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(logPrior()), tableSize() * sizeof(double));
+    if (!out) {
+      throw std::runtime_error("Failed to write model.");
+    }
+  }
+
+  static NaiveBayesClassifier load(const std::string& path) {
+    auto file = std::make_shared<const MappedFile>(path);
+    if (!file->isOpen() || file->size() < sizeof(Header)) {
+      throw std::runtime_error("Failed to open model.");
+    }
+    Header header;
+    std::memcpy(&header, file->begin(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.parties != PARTIES || header.values != VALUES ||
+        file->size() != sizeof(Header) + (PARTIES + PARTIES * header.attributeCount * VALUES) * sizeof(double)) {
+      throw std::runtime_error("Invalid model file.");
+    }
+
+    NaiveBayesClassifier classifier;
+    classifier.attributeCount = header.attributeCount;
+    classifier.mapping = std::move(file);
+    return classifier;
+  }
+
+  size_t getAttributeCount() const {
+    return attributeCount;
+  }
+
   bool predict(const Person& person) const {
-    Party predictedParty = std::max({Party::D, Party::R}, [&](const Party a, const Party b) {
-      return probability(person.attributes, a) < probability(person.attributes, b);
-    });
-    return person.party == predictedParty;
+    return person.party == classify(person.attributes);
+  }
+
+  Party classify(const std::vector<Attribute>& attributes) const {
+    if (attributes.size() != attributeCount) {
+      throw std::invalid_argument("Attribute count does not match the model.");
+    }
+    std::array<double, PARTIES> scores = {logPrior()[0], logPrior()[1]};
+    for (size_t party = 0; party < PARTIES; party++) {
+      const double* table = logLikelihood() + party * attributeCount * VALUES;
+      for (size_t i = 0; i < attributeCount; i++) {
+        scores[party] += table[i * VALUES + (size_t)attributes[i]];
+      }
+    }
+    return scores[(size_t)Party::R] > scores[(size_t)Party::D] ? Party::R : Party::D;
+  }
+
+  // Scores rows [begin, end) of a packed dataset; predictions[i] is the class of row
+  // begin + i. Works on 64 rows at a time with the republican-minus-democrat score of
+  // each row: every row starts from the UNK terms of all attributes and the NAY and YAY
+  // planes add the difference to their own terms. The inner loops are branch-free for
+  // vectorisation.
+  void classify(const ColumnarDataset& rows, size_t begin, size_t end, std::vector<Party>& predictions) const {
+    std::vector<double> nayDelta, yayDelta;
+    const double base = deltas(rows, nayDelta, yayDelta);
+
+    predictions.resize(end - begin);
+    std::array<double, 64> scores;
+    for (size_t w = begin / 64; w * 64 < end; w++) {
+      scores.fill(base);
+      for (size_t i = 0; i < attributeCount; i++) {
+        const uint64_t nays = rows.planes[rows.plane(i, Attribute::NAY) + w];
+        const uint64_t yays = rows.planes[rows.plane(i, Attribute::YAY) + w];
+        for (size_t r = 0; r < 64; r++) {
+          scores[r] += (double)(nays >> r & 1) * nayDelta[i] + (double)(yays >> r & 1) * yayDelta[i];
+        }
+      }
+      const size_t from = std::max(begin, w * 64), to = std::min(end, w * 64 + 64);
+      for (size_t row = from; row < to; row++) {
+        predictions[row - begin] = scores[row - w * 64] > 0 ? Party::R : Party::D;
+      }
+    }
+  }
+
+  void classify(const ColumnarDataset& rows, std::vector<Party>& predictions) const {
+    classify(rows, 0, rows.rows, predictions);
+  }
+
+  // Scores the rows at the given indices of a packed dataset one at a time with the same
+  // terms as the batch above; predictions[i] is the class of row indices[i].
+  void classify(const ColumnarDataset& rows, std::span<const size_t> indices, std::vector<Party>& predictions) const {
+    std::vector<double> nayDelta, yayDelta;
+    const double base = deltas(rows, nayDelta, yayDelta);
+
+    predictions.resize(indices.size());
+    for (size_t k = 0; k < indices.size(); k++) {
+      const size_t w = indices[k] / 64, r = indices[k] % 64;
+      double score = base;
+      for (size_t i = 0; i < attributeCount; i++) {
+        score += (double)(rows.planes[rows.plane(i, Attribute::NAY) + w] >> r & 1) * nayDelta[i] +
+                 (double)(rows.planes[rows.plane(i, Attribute::YAY) + w] >> r & 1) * yayDelta[i];
+      }
+      predictions[k] = score > 0 ? Party::R : Party::D;
+    }
   }
 
 private:
-  double probability(const std::vector<Attribute>& attributes, const Party& party) const {
-    const auto& attrMap = map.at(party);
-    const int partyCount = countByParty(party);
-    const int lambda = 1;
-    const int k = 2;
+  // The republican-minus-democrat score of a row with every attribute UNK, and what a
+  // NAY or YAY of each attribute adds to it.
+  double deltas(const ColumnarDataset& rows, std::vector<double>& nayDelta, std::vector<double>& yayDelta) const {
+    if (rows.attributeCount != attributeCount) {
+      throw std::invalid_argument("Attribute count does not match the model.");
+    }
 
-    double probability = 0.0;
-    for (size_t i = 0; i < attributes.size(); i++) {
-      size_t matchCount = attrMap.at(attributes[i])[i];
-      probability += std::log((double)(matchCount + lambda) / (partyCount + (k * lambda)));
+    double base = logPrior()[(size_t)Party::R] - logPrior()[(size_t)Party::D];
+    nayDelta.resize(attributeCount);
+    yayDelta.resize(attributeCount);
+    for (size_t i = 0; i < attributeCount; i++) {
+      const double unk = difference(i, Attribute::UNK);
+      base += unk;
+      nayDelta[i] = difference(i, Attribute::NAY) - unk;
+      yayDelta[i] = difference(i, Attribute::YAY) - unk;
     }
-    probability += std::log((double)(partyCount + lambda) / (dataset.size() + (k * lambda)));
-    return probability;
+    return base;
+  }
+
+  size_t index(size_t party, size_t attribute, Attribute value) const {
+    return (party * attributeCount + attribute) * VALUES + (size_t)value;
+  }
+
+  size_t tableSize() const {
+    return PARTIES + PARTIES * attributeCount * VALUES;
+  }
+
+  const double* logPrior() const {
+    return mapping ? reinterpret_cast<const double*>(mapping->begin() + sizeof(Header)) : tables.data();
+  }
+
+  const double* logLikelihood() const {
+    return logPrior() + PARTIES;
   }
 
-  size_t countByParty(const Party party) const {
-    return std::count_if(dataset.begin(), dataset.end(), [&](const auto& p){ return p.party == party; });
+  double difference(size_t attribute, Attribute value) const {
+    return logLikelihood()[index((size_t)Party::R, attribute, value)] -
+           logLikelihood()[index((size_t)Party::D, attribute, value)];
   }
 };
 
-static void splitTrainTest(const std::vector<Person>& dataset, std::vector<Person>& train, std::vector<Person>& test, const double ratio) {
-  std::unordered_map<Party, std::vector<Person>> partySplit;
-  for (const auto& p : dataset) {
-    partySplit[p.party].push_back(p);
+// Learns from one row at a time in memory independent of the number of rows: only the
+// counts are kept. publish() turns the current counts into an immutable model that
+// serving threads pick up with model() while rows keep coming in.
+class OnlineNaiveBayes {
+private:
+  NaiveBayesCounts counts;
+  std::atomic<std::shared_ptr<const NaiveBayesClassifier>> published;
+
+public:
+  // Called from the ingesting thread only.
+  void add(const Person& person) {
+    counts.add(person);
   }
 
-  train.clear();
-  test.clear();
-  for (const auto& party : partySplit) {
-    std::vector<Person> datasetParty = party.second;
-    size_t trainSize = ratio * datasetParty.size();
+  void publish() {
+    auto model = std::make_shared<NaiveBayesClassifier>();
+    model->train(counts);
+    published.store(std::move(model));
+  }
 
-    std::shuffle(datasetParty.begin(), datasetParty.end(), rnde);
+  // The last published model, or null before the first publish(). Safe from any thread.
+  std::shared_ptr<const NaiveBayesClassifier> model() const {
+    return published.load();
+  }
 
-    std::vector<Person> trainParty(datasetParty.begin(), datasetParty.begin() + trainSize);
-    std::vector<Person> testParty(datasetParty.begin() + trainSize, datasetParty.end());
-    
-    train.insert(train.end(), trainParty.begin(), trainParty.end());
-    test.insert(test.end(), testParty.begin(), testParty.end());
+  size_t rows() const {
+    return counts.rows;
   }
+};
 
-  std::shuffle(train.begin(), train.end(), rnde);
-  std::shuffle(test.begin(), test.end(), rnde);
-}
+// Actual against predicted class of the scored rows, for the two parties or any other
+// number of classes. Precision, recall and F1 are averaged over all classes (macro), so
+// no class is taken as the positive one. A default Confusion has no classes yet and
+// takes those of the first one added to it.
+struct Confusion {
+  size_t classes = 0;
+  // counts[actual * classes + predicted]
+  std::vector<size_t> counts;
+
+  Confusion() = default;
+
+  explicit Confusion(size_t classes)
+    : classes(classes), counts(classes * classes, 0) {
+  }
+
+  void add(size_t actual, size_t predicted) {
+    counts[actual * classes + predicted]++;
+  }
+
+  Confusion& operator+=(const Confusion& other) {
+    if (classes == 0) {
+      return *this = other;
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+      counts[i] += other.counts[i];
+    }
+    return *this;
+  }
+
+  size_t total() const {
+    return std::accumulate(counts.begin(), counts.end(), size_t(0));
+  }
+
+  double accuracy() const {
+    size_t correct = 0;
+    for (size_t cls = 0; cls < classes; cls++) {
+      correct += hits(cls);
+    }
+    return ratio(correct, total());
+  }
+
+  double precision() const {
+    return macro([&](size_t cls) { return ratio(hits(cls), predicted(cls)); });
+  }
+
+  double recall() const {
+    return macro([&](size_t cls) { return ratio(hits(cls), actual(cls)); });
+  }
+
+  double f1() const {
+    return macro([&](size_t cls) { return ratio(2 * hits(cls), predicted(cls) + actual(cls)); });
+  }
 
-double calculateAccuracy(const std::vector<Person>& train, const std::vector<Person>& test) {
-  NaiveBayesClassifier classifier(train);
-  classifier.train();
+private:
+  size_t hits(size_t cls) const {
+    return counts[cls * classes + cls];
+  }
 
-  size_t predictions = 0;
-  for (const Person& individual : test) {
-    if (classifier.predict(individual)) {
-      predictions++;
+  size_t predicted(size_t cls) const {
+    size_t sum = 0;
+    for (size_t other = 0; other < classes; other++) {
+      sum += counts[other * classes + cls];
     }
+    return sum;
+  }
+
+  size_t actual(size_t cls) const {
+    return std::accumulate(counts.begin() + cls * classes, counts.begin() + (cls + 1) * classes, size_t(0));
+  }
+
+  static double ratio(size_t numerator, size_t denominator) {
+    return denominator ? (double)numerator / denominator : 0.0;
   }
 
-  return (double)(predictions) / test.size();
+  template <typename F>
+  double macro(F f) const {
+    double sum = 0.0;
+    for (size_t cls = 0; cls < classes; cls++) {
+      sum += f(cls);
+    }
+    return classes ? sum / classes : 0.0;
+  }
+};
+
+using Metric = double (Confusion::*)() const;
+
+static Confusion evaluate(const NaiveBayesClassifier& classifier, const ColumnarDataset& rows, std::span<const size_t> indices) {
+  std::vector<Party> predicted;
+  classifier.classify(rows, indices, predicted);
+
+  Confusion confusion(rows.classes());
+  for (size_t i = 0; i < indices.size(); i++) {
+    confusion.add(rows.label(indices[i]), (size_t)predicted[i]);
+  }
+  return confusion;
 }
 
-std::vector<double> calculateKFoldAccuracy(const std::vector<Person>& dataset, const size_t K, double& mean, double& stdev) {
-  const size_t testSize = dataset.size() / K;
+// One split of an evaluation and the time it took to count, train and score it.
+struct EvaluationResult {
+  size_t repeat = 0;
+  size_t fold = 0;
+  Confusion confusion;
+  double seconds = 0.0;
+};
 
-  std::vector<double> accuracies;
-  for (size_t i = 0; i < K; i++) {
-    std::vector<Person> test;
-    std::vector<Person> train;
-    size_t testStart = i * testSize;
+// Resampling estimates of a classifier on some rows of a dataset. A split is a list of
+// row indices into the same dataset and its model is trained from the counts of those
+// indices (or of all evaluated rows minus the test indices), so no row is copied.
+// Splits run in parallel. Each random draw comes from an engine seeded with the
+// evaluation seed and the number of its split, so the results do not depend on the
+// number of threads.
+//
+// The Classifier names its Data, which gives label(row) and classes(), and its Counts,
+// which are counted with Counts::count(data, indices) and subtract. It trains from
+// Counts, and evaluate(classifier, data, indices) scores it.
+template <typename Classifier>
+class Evaluation {
+private:
+  using clock = std::chrono::steady_clock;
+  using Data = typename Classifier::Data;
+  using Counts = typename Classifier::Counts;
+
+  enum class Stream : uint64_t {
+    FOLDS,
+    BOOTSTRAP,
+  };
+
+  const Data& data;
+  std::vector<size_t> rows;
+  uint64_t seed;
+  size_t threads;
+  Counts total;
+
+public:
+  Evaluation(const Data& data, std::vector<size_t> rows, uint64_t seed,
+             size_t threads = std::thread::hardware_concurrency())
+    : data(data), rows(std::move(rows)), seed(seed), threads(std::max<size_t>(threads, 1)),
+      total(Counts::count(data, this->rows)) {
+    if (this->rows.size() < 2) {
+      throw std::invalid_argument("At least two rows are needed for an evaluation.");
+    }
+  }
+
+  // Stratified K-fold cross-validation over several shuffles. Each class is shuffled on
+  // its own and dealt to the folds in turn, so every fold keeps the class ratio. Results
+  // are ordered by repeat, then fold.
+  std::vector<EvaluationResult> crossValidate(size_t K, size_t repeats) const {
+    if (K < 2 || K > rows.size()) {
+      throw std::invalid_argument("Fold count must be between 2 and the number of rows.");
+    }
+
+    std::vector<std::vector<std::vector<size_t>>> folds(repeats);
+    parallel(repeats, [&](size_t repeat) {
+      folds[repeat] = stratifiedFolds(K, engine(Stream::FOLDS, repeat));
+    });
+
+    std::vector<EvaluationResult> results(repeats * K);
+    parallel(results.size(), [&](size_t task) {
+      const clock::time_point start = clock::now();
+      const std::vector<size_t>& test = folds[task / K][task % K];
+      const Confusion confusion = score(total - Counts::count(data, test), test);
+      results[task] = {task / K, task % K, confusion, since(start)};
+    });
+    return results;
+  }
+
+  std::vector<EvaluationResult> leaveOneOut() const {
+    std::vector<EvaluationResult> results(rows.size());
+    parallel(results.size(), [&](size_t task) {
+      const clock::time_point start = clock::now();
+      const std::span<const size_t> test(&rows[task], 1);
+      const Confusion confusion = score(total - Counts::count(data, test), test);
+      results[task] = {0, task, confusion, since(start)};
+    });
+    return results;
+  }
+
+  // Trains on samples drawn with replacement from the evaluated rows, as many as there
+  // are rows, and scores each model on the rows its sample left out (out-of-bag).
+  std::vector<EvaluationResult> bootstrap(size_t samples) const {
+    std::vector<EvaluationResult> results(samples);
+    parallel(samples, [&](size_t task) {
+      const clock::time_point start = clock::now();
+      std::mt19937_64 rng = engine(Stream::BOOTSTRAP, task);
+      std::uniform_int_distribution<size_t> pick(0, rows.size() - 1);
+
+      std::vector<size_t> sample(rows.size());
+      std::vector<bool> drawn(data.rows);
+      for (size_t& row : sample) {
+        row = rows[pick(rng)];
+        drawn[row] = true;
+      }
+      std::vector<size_t> outOfBag;
+      for (const size_t row : rows) {
+        if (!drawn[row]) {
+          outOfBag.push_back(row);
+        }
+      }
+
+      const Confusion confusion = score(Counts::count(data, sample), outOfBag);
+      results[task] = {0, task, confusion, since(start)};
+    });
+    return results;
+  }
+
+private:
+  Confusion score(const Counts& counts, std::span<const size_t> test) const {
+    Classifier classifier;
+    classifier.train(counts);
+    return evaluate(classifier, data, test);
+  }
+
+  std::vector<std::vector<size_t>> stratifiedFolds(size_t K, std::mt19937_64 rng) const {
+    std::vector<std::vector<size_t>> classes(data.classes());
+    for (const size_t row : rows) {
+      classes[data.label(row)].push_back(row);
+    }
+
+    std::vector<std::vector<size_t>> folds(K);
+    size_t next = 0;
+    for (std::vector<size_t>& cls : classes) {
+      std::shuffle(cls.begin(), cls.end(), rng);
+      for (const size_t row : cls) {
+        folds[next].push_back(row);
+        next = (next + 1) % K;
+      }
+    }
+    return folds;
+  }
+
+  // splitmix64 over the seed, the stream and the task.
+  std::mt19937_64 engine(Stream stream, uint64_t task) const {
+    uint64_t z = seed;
+    for (const uint64_t x : {(uint64_t)stream, task}) {
+      z = (z ^ x) + 0x9e3779b97f4a7c15;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      z ^= z >> 31;
+    }
+    return std::mt19937_64(z);
+  }
 
-    train.insert(train.end(), dataset.begin(), dataset.begin() + testStart);
-    test.insert(test.end(), dataset.begin() + testStart, dataset.begin() + testStart + testSize);
-    train.insert(train.end(), dataset.begin() + testStart + testSize, dataset.end());
+  // Runs f(0) .. f(count - 1) on up to threads threads, each taking the next task when
+  // it is done with one.
+  template <typename F>
+  void parallel(size_t count, F f) const {
+    std::atomic<size_t> next = 0;
+    const auto work = [&] {
+      for (size_t task; (task = next++) < count;) {
+        f(task);
+      }
+    };
 
-    double accuracy = calculateAccuracy(train, test);
-    accuracies.push_back(accuracy);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, count); i++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
   }
 
-  double sum = std::accumulate(accuracies.begin(), accuracies.end(), 0.0);
-  mean = sum / accuracies.size();
+  static double since(clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  }
+};
 
+// Mean and standard deviation of a metric over the results that scored any rows.
+static void summarize(const std::vector<EvaluationResult>& results, Metric metric, double& mean, double& stdev) {
+  std::vector<double> values;
+  for (const EvaluationResult& result : results) {
+    if (result.confusion.total()) {
+      values.push_back((result.confusion.*metric)());
+    }
+  }
+
+  mean = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
   double sq_sum = 0.0;
-  for (double acc : accuracies) {
-    sq_sum += std::pow(acc - mean, 2);
+  for (double value : values) {
+    sq_sum += std::pow(value - mean, 2);
+  }
+  stdev = values.empty() ? 0.0 : std::sqrt(sq_sum / values.size());
+}
+
+// Nearest-rank p-quantile of a metric over the results that scored any rows.
+static double percentile(const std::vector<EvaluationResult>& results, Metric metric, double p) {
+  std::vector<double> values;
+  for (const EvaluationResult& result : results) {
+    if (result.confusion.total()) {
+      values.push_back((result.confusion.*metric)());
+    }
+  }
+  if (values.empty()) {
+    return 0.0;
   }
-  stdev = std::sqrt(sq_sum / accuracies.size());
 
-  return accuracies;
+  std::sort(values.begin(), values.end());
+  const size_t rank = (size_t)std::ceil(p * values.size());
+  return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
 }
 
-void solve(const std::vector<Person>& dataset) {
-  std::vector<Person> train, test;
-  splitTrainTest(dataset, train, test, 0.8);
+// Any CSV with one class column, typed once on load. A feature column is numeric when
+// every value after the first row parses as a number ("?" and empty values are
+// missing); the first row is taken as a header when it does not parse in such a
+// column. Every other column, and the class, is dictionary-encoded to dense ids in
+// order of first appearance.
+struct EncodedDataset {
+  enum class Kind {
+    CATEGORICAL,
+    NUMERIC,
+  };
+
+  struct Column {
+    std::string name;
+    Kind kind;
+    std::vector<std::string> values;
+    std::vector<uint32_t> codes;
+    // NaN where the value is missing.
+    std::vector<double> numbers;
+  };
+
+  size_t rows = 0;
+  std::vector<Column> features;
+  std::vector<std::string> classNames;
+  std::vector<uint32_t> labels;
+
+  size_t label(size_t row) const {
+    return labels[row];
+  }
+
+  size_t classes() const {
+    return classNames.size();
+  }
+
+  static EncodedDataset infer(const CSV& csv, const size_t classColumn) {
+    if (csv.empty()) {
+      throw std::runtime_error("Empty dataset.");
+    }
+    const size_t width = csv.front().size();
+    for (const CSVLine& line : csv) {
+      if (line.size() != width) {
+        throw std::runtime_error("Inconsistent attribute count.");
+      }
+    }
+    if (classColumn >= width) {
+      throw std::invalid_argument("Class column out of range.");
+    }
+
+    std::vector<bool> numeric(width, false);
+    bool header = false;
+    for (size_t c = 0; c < width; c++) {
+      if (c == classColumn) continue;
+      bool all = true, any = false;
+      double value;
+      for (size_t r = 1; r < csv.size() && all; r++) {
+        if (isMissing(csv[r][c])) continue;
+        any = true;
+        all = parseNumber(csv[r][c], value);
+      }
+      numeric[c] = all && any;
+      if (numeric[c] && !isMissing(csv[0][c]) && !parseNumber(csv[0][c], value)) {
+        header = true;
+      }
+    }
+
+    EncodedDataset data;
+    const size_t first = header ? 1 : 0;
+    data.rows = csv.size() - first;
+    std::unordered_map<std::string_view, uint32_t> classIds;
+    for (size_t r = first; r < csv.size(); r++) {
+      data.labels.push_back(encode(csv[r][classColumn], classIds, data.classNames));
+    }
+
+    for (size_t c = 0; c < width; c++) {
+      if (c == classColumn) continue;
+      Column column;
+      column.name = header ? std::string(csv[0][c]) : "column " + std::to_string(c + 1);
+      column.kind = numeric[c] ? Kind::NUMERIC : Kind::CATEGORICAL;
+      std::unordered_map<std::string_view, uint32_t> ids;
+      for (size_t r = first; r < csv.size(); r++) {
+        if (column.kind == Kind::CATEGORICAL) {
+          column.codes.push_back(encode(csv[r][c], ids, column.values));
+        } else {
+          double value = std::numeric_limits<double>::quiet_NaN();
+          if (!isMissing(csv[r][c])) parseNumber(csv[r][c], value);
+          column.numbers.push_back(value);
+        }
+      }
+      data.features.push_back(std::move(column));
+    }
+    return data;
+  }
+
+private:
+  static bool isMissing(const std::string_view str) {
+    return str.empty() || str == "?";
+  }
+
+  static bool parseNumber(const std::string_view str, double& value) {
+    const char* end = str.data() + str.size();
+    const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+    return ec == std::errc() && ptr == end;
+  }
+
+  // Ids are keyed by views into the CSV, so a value is only copied the first time.
+  static uint32_t encode(const std::string_view value, std::unordered_map<std::string_view, uint32_t>& ids,
+                         std::vector<std::string>& names) {
+    const auto [it, inserted] = ids.try_emplace(value, names.size());
+    if (inserted) {
+      names.emplace_back(value);
+    }
+    return it->second;
+  }
+};
+
+
+// Laplace-smoothed likelihoods of all categorical columns in one dense table indexed
+// [class][offset of column + value], so a row costs one lookup per column and class.
+class CategoricalEncoding {
+public:
+  // Rows of every class with every value of every categorical column, laid out like the
+  // table.
+  struct Counts {
+    std::vector<size_t> columns;
+    // offsets[j]: first cell of columns[j]; the last entry is the width of a class.
+    std::vector<size_t> offsets;
+    std::vector<size_t> cells;
+
+    static Counts count(const EncodedDataset& data, std::span<const size_t> rows) {
+      Counts counts;
+      counts.offsets.push_back(0);
+      for (size_t c = 0; c < data.features.size(); c++) {
+        if (data.features[c].kind == EncodedDataset::Kind::CATEGORICAL) {
+          counts.columns.push_back(c);
+          counts.offsets.push_back(counts.offsets.back() + data.features[c].values.size());
+        }
+      }
+
+      const size_t width = counts.offsets.back();
+      counts.cells.assign(data.classes() * width, 0);
+      for (size_t j = 0; j < counts.columns.size(); j++) {
+        const std::vector<uint32_t>& codes = data.features[counts.columns[j]].codes;
+        for (const size_t row : rows) {
+          counts.cells[data.labels[row] * width + counts.offsets[j] + codes[row]]++;
+        }
+      }
+      return counts;
+    }
+
+    Counts& operator-=(const Counts& other) {
+      for (size_t i = 0; i < cells.size(); i++) {
+        cells[i] -= other.cells[i];
+      }
+      return *this;
+    }
+  };
+
+private:
+  std::vector<size_t> columns;
+  std::vector<size_t> offsets;
+  size_t width = 0;
+  std::vector<double> logLikelihood;
+
+public:
+  void fit(const Counts& counts, const std::vector<size_t>& classCounts) {
+    const int lambda = 1;
+
+    columns = counts.columns;
+    offsets = counts.offsets;
+    width = offsets.back();
+    logLikelihood.assign(classCounts.size() * width, 0.0);
+    for (size_t cls = 0; cls < classCounts.size(); cls++) {
+      for (size_t j = 0; j < columns.size(); j++) {
+        const size_t k = offsets[j + 1] - offsets[j];
+        const double denominator = std::log((double)(classCounts[cls] + k * lambda));
+        for (size_t v = 0; v < k; v++) {
+          const size_t cell = cls * width + offsets[j] + v;
+          logLikelihood[cell] = std::log((double)(counts.cells[cell] + lambda)) - denominator;
+        }
+      }
+    }
+  }
+
+  void score(const EncodedDataset& data, size_t row, std::vector<double>& scores) const {
+    for (size_t cls = 0; cls < scores.size(); cls++) {
+      const double* table = &logLikelihood[cls * width];
+      for (size_t j = 0; j < columns.size(); j++) {
+        scores[cls] += table[offsets[j] + data.features[columns[j]].codes[row]];
+      }
+    }
+  }
+};
+
+
+// Normal distribution per class and numeric column. Variances get a small share of the
+// largest variance added so constant columns stay finite; missing values are skipped.
+class GaussianEncoding {
+public:
+  // Count, sum and sum of squares of the present values of every class and numeric
+  // column, [class * columns + column]. Values are taken relative to a shift, the
+  // column's first present value in the dataset, so the variance from the sums keeps
+  // its precision; the shift depends only on the dataset, so counts of different rows
+  // still subtract.
+  struct Counts {
+    std::vector<size_t> columns;
+    std::vector<double> shifts;
+    std::vector<size_t> seen;
+    std::vector<double> sums;
+    std::vector<double> squares;
 
-  double trainAccuracy = calculateAccuracy(train, train);
+    static Counts count(const EncodedDataset& data, std::span<const size_t> rows) {
+      Counts counts;
+      for (size_t c = 0; c < data.features.size(); c++) {
+        if (data.features[c].kind == EncodedDataset::Kind::NUMERIC) {
+          const std::vector<double>& numbers = data.features[c].numbers;
+          const auto present = std::find_if(numbers.begin(), numbers.end(), [](double x) { return !std::isnan(x); });
+          counts.columns.push_back(c);
+          counts.shifts.push_back(present == numbers.end() ? 0.0 : *present);
+        }
+      }
+
+      const size_t n = counts.columns.size();
+      counts.seen.assign(data.classes() * n, 0);
+      counts.sums.assign(data.classes() * n, 0.0);
+      counts.squares.assign(data.classes() * n, 0.0);
+      for (size_t j = 0; j < n; j++) {
+        const std::vector<double>& numbers = data.features[counts.columns[j]].numbers;
+        for (const size_t row : rows) {
+          if (std::isnan(numbers[row])) continue;
+          const size_t cell = data.labels[row] * n + j;
+          const double x = numbers[row] - counts.shifts[j];
+          counts.seen[cell]++;
+          counts.sums[cell] += x;
+          counts.squares[cell] += x * x;
+        }
+      }
+      return counts;
+    }
+
+    Counts& operator-=(const Counts& other) {
+      for (size_t cell = 0; cell < seen.size(); cell++) {
+        seen[cell] -= other.seen[cell];
+        sums[cell] -= other.sums[cell];
+        squares[cell] -= other.squares[cell];
+      }
+      return *this;
+    }
+  };
+
+private:
+  std::vector<size_t> columns;
+  // [class * columns + column]
+  std::vector<double> means;
+  std::vector<double> variances;
+
+public:
+  void fit(const Counts& counts, const std::vector<size_t>&) {
+    const double varianceSmoothing = 1e-9;
+
+    columns = counts.columns;
+    const size_t n = columns.size();
+    means.assign(counts.seen.size(), 0.0);
+    variances.assign(counts.seen.size(), 0.0);
+    double largest = 0.0;
+    for (size_t cell = 0; cell < counts.seen.size(); cell++) {
+      const size_t seen = counts.seen[cell];
+      if (seen) {
+        const double mean = counts.sums[cell] / seen;
+        means[cell] = counts.shifts[cell % n] + mean;
+        variances[cell] = std::max(counts.squares[cell] / seen - mean * mean, 0.0);
+      }
+      largest = std::max(largest, variances[cell]);
+    }
+    const double epsilon = std::max(varianceSmoothing * largest, std::numeric_limits<double>::min());
+    for (double& variance : variances) {
+      variance += epsilon;
+    }
+  }
+
+  void score(const EncodedDataset& data, size_t row, std::vector<double>& scores) const {
+    const size_t n = columns.size();
+    for (size_t j = 0; j < n; j++) {
+      const double x = data.features[columns[j]].numbers[row];
+      if (std::isnan(x)) continue;
+      for (size_t cls = 0; cls < scores.size(); cls++) {
+        const double mean = means[cls * n + j], variance = variances[cls * n + j];
+        scores[cls] -= 0.5 * std::log(2 * std::numbers::pi * variance) + (x - mean) * (x - mean) / (2 * variance);
+      }
+    }
+  }
+};
+
+
+// Several encodings side by side, each handling its own columns.
+template <typename... Encodings>
+class CombinedEncoding : private Encodings... {
+public:
+  struct Counts : Encodings::Counts... {
+    static Counts count(const EncodedDataset& data, std::span<const size_t> rows) {
+      return Counts{Encodings::Counts::count(data, rows)...};
+    }
+
+    Counts& operator-=(const Counts& other) {
+      (Encodings::Counts::operator-=(other), ...);
+      return *this;
+    }
+  };
+
+  void fit(const Counts& counts, const std::vector<size_t>& classCounts) {
+    (Encodings::fit(counts, classCounts), ...);
+  }
+
+  void score(const EncodedDataset& data, size_t row, std::vector<double>& scores) const {
+    (Encodings::score(data, row, scores), ...);
+  }
+};
+
+
+// Naive Bayes over any number of classes. The Encoding decides how feature columns turn
+// into log-likelihoods: its Counts gather what it needs from some rows, fit() learns
+// from them and score() adds the log-likelihood of one row under every class.
+template <typename Encoding>
+class GenericNaiveBayes {
+public:
+  using Data = EncodedDataset;
+
+  // Class and feature counts of a multiset of rows. Counts are additive, so the counts
+  // of any subset can be taken away from those of the whole set.
+  struct Counts {
+    std::vector<size_t> classes;
+    typename Encoding::Counts features;
+
+    static Counts count(const EncodedDataset& data, std::span<const size_t> rows) {
+      Counts counts{std::vector<size_t>(data.classes(), 0), Encoding::Counts::count(data, rows)};
+      for (const size_t row : rows) {
+        counts.classes[data.labels[row]]++;
+      }
+      return counts;
+    }
+
+    Counts operator-(const Counts& other) const {
+      Counts result = *this;
+      for (size_t cls = 0; cls < classes.size(); cls++) {
+        result.classes[cls] -= other.classes[cls];
+      }
+      result.features -= other.features;
+      return result;
+    }
+  };
+
+private:
+  std::vector<double> logPrior;
+  Encoding encoding;
+
+public:
+  void train(const Counts& counts) {
+    const int lambda = 1;
+    const size_t classes = counts.classes.size();
+    const size_t rows = std::accumulate(counts.classes.begin(), counts.classes.end(), size_t(0));
+
+    logPrior.resize(classes);
+    for (size_t cls = 0; cls < classes; cls++) {
+      logPrior[cls] = std::log((double)(counts.classes[cls] + lambda) / (rows + classes * lambda));
+    }
+    encoding.fit(counts.features, counts.classes);
+  }
+
+  uint32_t classify(const EncodedDataset& data, size_t row) const {
+    std::vector<double> scores = logPrior;
+    encoding.score(data, row, scores);
+    return std::max_element(scores.begin(), scores.end()) - scores.begin();
+  }
+};
+
+template <typename Encoding>
+static Confusion evaluate(const GenericNaiveBayes<Encoding>& classifier, const EncodedDataset& data,
+                          std::span<const size_t> indices) {
+  Confusion confusion(data.classes());
+  for (const size_t row : indices) {
+    confusion.add(data.label(row), classifier.classify(data, row));
+  }
+  return confusion;
+}
+
+using MixedNaiveBayes = GenericNaiveBayes<CombinedEncoding<CategoricalEncoding, GaussianEncoding>>;
+
+// Stratified split of row indices, shuffled within every class.
+static void splitTrainTest(const std::vector<uint32_t>& labels, std::vector<size_t>& train, std::vector<size_t>& test, const double ratio) {
+  std::unordered_map<uint32_t, std::vector<size_t>> classSplit;
+  for (size_t row = 0; row < labels.size(); row++) {
+    classSplit[labels[row]].push_back(row);
+  }
+
+  train.clear();
+  test.clear();
+  for (auto& cls : classSplit) {
+    std::vector<size_t>& rows = cls.second;
+    const size_t trainSize = ratio * rows.size();
+    std::shuffle(rows.begin(), rows.end(), rnde);
+    train.insert(train.end(), rows.begin(), rows.begin() + trainSize);
+    test.insert(test.end(), rows.begin() + trainSize, rows.end());
+  }
+
+  std::shuffle(train.begin(), train.end(), rnde);
+  std::shuffle(test.begin(), test.end(), rnde);
+}
+
+struct EvaluationOptions {
+  size_t folds = 10;
+  size_t repeats = 1;
+  bool leaveOneOut = false;
+  size_t bootstraps = 0;
+  uint64_t seed = rndd();
+  size_t threads = std::thread::hardware_concurrency();
+};
+
+// Trains on the train rows and reports its accuracy, the resampling estimates on the
+// train rows asked for by the options and the accuracy on the test rows.
+template <typename Classifier>
+static void report(const typename Classifier::Data& data, const std::vector<size_t>& train,
+                   const std::vector<size_t>& test, const EvaluationOptions& options) {
+  static const std::pair<const char*, Metric> metrics[] = {
+    {"Accuracy", &Confusion::accuracy},
+    {"Precision", &Confusion::precision},
+    {"Recall", &Confusion::recall},
+    {"F1", &Confusion::f1},
+  };
+
+  const Evaluation<Classifier> evaluation(data, train, options.seed, options.threads);
+  Classifier classifier;
+  classifier.train(Classifier::Counts::count(data, train));
   std::cout << "1. Train Set Accuracy:" << std::endl
-            << "   Accuracy: " << trainAccuracy * 100 << "%" << std::endl;
+            << "   Accuracy: " << evaluate(classifier, data, train).accuracy() * 100 << "%" << std::endl;
 
-  int K = 10;
-  double mean, stdev;
-  std::vector<double> accuracies = calculateKFoldAccuracy(train, K, mean, stdev);
-  std::cout << K << "-Fold Cross-Validation Results:" << std::endl;
-  for (size_t i = 0; i < accuracies.size(); i++) {
-    std::cout << "    Accuracy Fold " << (i+1) << ": "<< accuracies[i] * 100 << "%"  << std::endl;
+  const std::vector<EvaluationResult> folds = evaluation.crossValidate(options.folds, options.repeats);
+  std::cout << options.folds << "-Fold Cross-Validation Results";
+  if (options.repeats > 1) {
+    std::cout << " (" << options.repeats << " repeats)";
+  }
+  std::cout << ":" << std::endl;
+  for (const EvaluationResult& fold : folds) {
+    if (options.repeats > 1 && fold.fold == 0) {
+      std::cout << "  Repeat " << (fold.repeat + 1) << ":" << std::endl;
+    }
+    const Confusion& c = fold.confusion;
+    std::cout << "    Accuracy Fold " << (fold.fold + 1) << ": " << c.accuracy() * 100 << "%"
+              << ", Precision: " << c.precision() * 100 << "%, Recall: " << c.recall() * 100
+              << "%, F1: " << c.f1() * 100 << "%, Time: " << fold.seconds * 1000 << " ms" << std::endl;
   }
+  double mean, stdev;
+  summarize(folds, &Confusion::accuracy, mean, stdev);
   std::cout << std::endl
             << "    Average Accuracy: "<< mean * 100 << "%" << std::endl
             << "    Standard Deviation: "<< stdev * 100 << "%" << std::endl;
+  for (const auto& [name, metric] : std::span(metrics).subspan(1)) {
+    summarize(folds, metric, mean, stdev);
+    std::cout << "    Average " << name << ": " << mean * 100 << "% (sd " << stdev * 100 << "%)" << std::endl;
+  }
+
+  if (options.leaveOneOut) {
+    const std::vector<EvaluationResult> results = evaluation.leaveOneOut();
+    Confusion pooled;
+    double seconds = 0.0;
+    for (const EvaluationResult& result : results) {
+      pooled += result.confusion;
+      seconds += result.seconds;
+    }
+    std::cout << "Leave-One-Out Results (" << results.size() << " folds):" << std::endl;
+    for (const auto& [name, metric] : metrics) {
+      std::cout << "    " << name << ": " << (pooled.*metric)() * 100 << "%" << std::endl;
+    }
+    std::cout << "    Average Fold Time: " << seconds / results.size() * 1000 << " ms" << std::endl;
+  }
+
+  if (options.bootstraps) {
+    const std::vector<EvaluationResult> results = evaluation.bootstrap(options.bootstraps);
+    std::cout << "Bootstrap Results (" << results.size() << " samples, out-of-bag, 95% CI):" << std::endl;
+    for (const auto& [name, metric] : metrics) {
+      summarize(results, metric, mean, stdev);
+      std::cout << "    " << name << ": " << mean * 100 << "% [" << percentile(results, metric, 0.025) * 100
+                << "%, " << percentile(results, metric, 0.975) * 100 << "%]" << std::endl;
+    }
+  }
 
-  double testAccuracy = calculateAccuracy(train, test);
   std::cout << "2. Test Set Accuracy:" << std::endl
-            << "   Accuracy: " << testAccuracy * 100 << "%" << std::endl;
+            << "   Accuracy: " << evaluate(classifier, data, test).accuracy() * 100 << "%" << std::endl;
+}
+
+// Splits, trains and evaluates on row indices of one packed copy of the dataset. The
+// seed fixes the train/test split and every resampling below it.
+void solve(const std::vector<Person>& dataset, const EvaluationOptions& options) {
+  const ColumnarDataset packed = ColumnarDataset::pack(dataset);
+  std::vector<uint32_t> labels(packed.rows);
+  for (size_t row = 0; row < packed.rows; row++) {
+    labels[row] = (uint32_t)packed.party(row);
+  }
+
+  rnde.seed(options.seed);
+  std::vector<size_t> train, test;
+  splitTrainTest(labels, train, test, 0.8);
+  std::cout << "Seed: " << options.seed << std::endl;
+
+  report<NaiveBayesClassifier>(packed, train, test, options);
 }
 
 
+void solveGeneric(const EncodedDataset& data, const EvaluationOptions& options) {
+  std::cout << "Schema: " << data.rows << " rows, " << data.classNames.size() << " classes" << std::endl;
+  for (const EncodedDataset::Column& column : data.features) {
+    std::cout << "    " << column.name << ": ";
+    if (column.kind == EncodedDataset::Kind::NUMERIC) {
+      std::cout << "numeric" << std::endl;
+    } else {
+      std::cout << "categorical (" << column.values.size() << " values)" << std::endl;
+    }
+  }
+
+  rnde.seed(options.seed);
+  std::vector<size_t> train, test;
+  splitTrainTest(data.labels, train, test, 0.8);
+  std::cout << "Seed: " << options.seed << std::endl;
+
+  report<MixedNaiveBayes>(data, train, test, options);
+}
+
+
+// Reads rows from in as they arrive. Every row is first scored by the last published
+// model and then learned, and a new model is published every snapshotEvery rows.
+void stream(std::istream& in, const size_t snapshotEvery) {
+  OnlineNaiveBayes online;
+  size_t scored = 0, correct = 0;
+  const auto report = [&] {
+    online.publish();
+    std::cout << "Rows: " << online.rows() << ", Prequential Accuracy: "
+              << (scored ? (double)correct / scored * 100 : 0.0) << "%" << std::endl;
+  };
+
+  std::string line;
+  std::vector<std::string_view> fields;
+  std::deque<std::string> storage;
+  while (std::getline(in, line)) {
+    storage.clear();
+    CSVReader::splitLine(line, fields, storage);
+    if (fields.empty()) {
+      continue;
+    }
+    const Person person = DatasetReader::parseRow(fields);
+    if (const auto model = online.model()) {
+      scored++;
+      correct += model->predict(person);
+    }
+    online.add(person);
+    if (online.rows() % snapshotEvery == 0) {
+      report();
+    }
+  }
+  report();
+}
+
+
+// Prints the predicted party of every row in. Rows may leave out the party; when it is
+// there it is skipped for scoring and the accuracy over such rows goes to stderr.
+void score(const NaiveBayesClassifier& model, std::istream& in) {
+  size_t labelled = 0, correct = 0;
+  std::string line;
+  std::vector<std::string_view> cols;
+  std::deque<std::string> storage;
+  while (std::getline(in, line)) {
+    storage.clear();
+    CSVReader::splitLine(line, cols, storage);
+    if (cols.empty()) {
+      continue;
+    }
+    const bool hasParty = cols.size() == model.getAttributeCount() + 1;
+    const Party predicted = model.classify(DatasetReader::parseAttributes(cols, hasParty ? 1 : 0));
+    std::cout << DatasetReader::formatParty(predicted) << '\n';
+    if (hasParty) {
+      labelled++;
+      correct += DatasetReader::parseParty(cols[0]) == predicted;
+    }
+  }
+  std::cout << std::flush;
+  if (labelled) {
+    std::cerr << "Accuracy: " << (double)correct / labelled * 100 << "%" << std::endl;
+  }
+}
+
+// A path of "-" reads standard input.
+static std::istream& openInput(const std::string& path, std::ifstream& file) {
+  if (path == "-") {
+    return std::cin;
+  }
+  file.open(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file.");
+  }
+  return file;
+}
+
+// Usage: main <dataset> [mode] [-folds k] [-repeats r] [-loo] [-bootstrap samples]
+//                              [-seed s] [-threads n] [-save model]
+//        main <dataset> generic [class-column] [-folds k] [-repeats r] [-loo]
+//                              [-bootstrap samples] [-seed s] [-threads n]
+//        main <dataset|-> stream [rows-per-snapshot]
+//        main -model <model> [rows|-]
+
 int main(int argc, char* argv[]) {
   try {
     if (argc < 2) {
       throw std::runtime_error("Dataset file is required.");
     }
 
-    const int mode = argc >= 3 ? std::atoi(argv[2]) : 0;
+    std::ifstream file;
+    if (std::string(argv[1]) == "-model") {
+      if (argc < 3) {
+        throw std::runtime_error("Model file is required.");
+      }
+      const NaiveBayesClassifier model = NaiveBayesClassifier::load(argv[2]);
+      score(model, openInput(argc >= 4 ? argv[3] : "-", file));
+      return 0;
+    }
+
+    if (argc >= 3 && std::string(argv[2]) == "stream") {
+      const size_t snapshotEvery = std::max(argc >= 4 ? std::atoi(argv[3]) : 50, 1);
+      stream(openInput(argv[1], file), snapshotEvery);
+      return 0;
+    }
+
+    // The generic mode takes an optional class column where the others take a mode.
+    const bool generic = argc >= 3 && std::string(argv[2]) == "generic";
+    int first = 2, mode = 0;
+    size_t classColumn = 0;
+    if (generic) {
+      first = 3;
+      if (argc >= 4 && argv[3][0] != '-') {
+        classColumn = std::atoi(argv[3]);
+        first = 4;
+      }
+    } else if (argc >= 3 && argv[2][0] != '-') {
+      mode = std::atoi(argv[2]);
+      first = 3;
+    }
+    EvaluationOptions options;
+    std::string modelPath;
+    const std::vector<std::string> args(argv + first, argv + argc);
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (args[i] == "-save" && i + 1 < args.size()) {
+        modelPath = args[++i];
+      } else if (args[i] == "-folds" && i + 1 < args.size()) {
+        options.folds = std::stoul(args[++i]);
+      } else if (args[i] == "-repeats" && i + 1 < args.size()) {
+        options.repeats = std::max<size_t>(std::stoul(args[++i]), 1);
+      } else if (args[i] == "-loo") {
+        options.leaveOneOut = true;
+      } else if (args[i] == "-bootstrap" && i + 1 < args.size()) {
+        options.bootstraps = std::stoul(args[++i]);
+      } else if (args[i] == "-seed" && i + 1 < args.size()) {
+        options.seed = std::stoull(args[++i]);
+      } else if (args[i] == "-threads" && i + 1 < args.size()) {
+        options.threads = std::stoul(args[++i]);
+      } else {
+        throw std::runtime_error("Unknown option " + args[i] + ".");
+      }
+    }
+
+    if (generic) {
+      if (!modelPath.empty()) {
+        throw std::runtime_error("Only the party model can be saved.");
+      }
+      solveGeneric(EncodedDataset::infer(CSVReader::readFile(argv[1]), classColumn), options);
+      return 0;
+    }
+
     const CSV csv = CSVReader::readFile(argv[1]);
     const std::vector<Person> dataset = DatasetReader::readCSV(csv, mode);
-    solve(dataset);
+    solve(dataset, options);
+
+    if (!modelPath.empty()) {
+      NaiveBayesClassifier model;
+      model.train(ColumnarDataset::pack(dataset));
+      model.save(modelPath);
+    }
   } catch(const std::exception& e) {
     std::cerr << e.what() << std::endl;
     return -1;
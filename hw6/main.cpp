@@ -1,49 +1,270 @@
-// TODO: Pruning
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
 #include <cmath>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <optional>
+#include <queue>
 #include <random>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 std::random_device rndd;
 std::default_random_engine rnde(rndd());
 
-using CSVLine = std::vector<std::string>;
-using CSV = std::vector<CSVLine>;
+// Read-only memory mapping of a whole file. An empty file is open but maps nothing.
+class MappedFile {
+private:
+  const char* data = nullptr;
+  size_t length = 0;
+  bool opened = false;
+
+public:
+  MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+      opened = true;
+      if (st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          data = static_cast<const char*>(p);
+          length = st.st_size;
+        } else {
+          opened = false;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data) {
+      munmap(const_cast<char*>(data), length);
+    }
+  }
+
+  bool isOpen() const {
+    return opened;
+  }
+
+  const char* begin() const {
+    return data;
+  }
+
+  size_t size() const {
+    return length;
+  }
+};
+
+
+using CSVLine = std::span<const std::string_view>;
+
+// Rows of a CSV file as views into its memory mapping, so reading allocates per row
+// only for the index and never per field. Quoted fields that contain doubled quotes are
+// the only ones copied, unescaped, into storage owned by the table.
+class CSV {
+public:
+  class Iterator {
+  private:
+    const CSV* csv;
+    size_t row;
+
+  public:
+    Iterator(const CSV* csv, size_t row) : csv(csv), row(row) {}
+    CSVLine operator*() const { return (*csv)[row]; }
+    Iterator& operator++() { ++row; return *this; }
+    bool operator!=(const Iterator& other) const { return row != other.row; }
+  };
+
+private:
+  std::unique_ptr<MappedFile> file;
+  std::vector<std::string_view> fields;
+  // Fields of row r are fields[rowStarts[r]] up to fields[rowStarts[r + 1]].
+  std::vector<size_t> rowStarts{0};
+  // One store per parsing chunk, never resized, so views into it stay valid.
+  std::vector<std::deque<std::string>> unescaped;
+
+  friend class CSVReader;
+
+public:
+  size_t size() const {
+    return rowStarts.size() - 1;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  CSVLine operator[](size_t row) const {
+    return CSVLine(fields.data() + rowStarts[row], rowStarts[row + 1] - rowStarts[row]);
+  }
+
+  CSVLine front() const {
+    return (*this)[0];
+  }
+
+  Iterator begin() const {
+    return Iterator(this, 0);
+  }
+
+  Iterator end() const {
+    return Iterator(this, size());
+  }
+};
+
 
+// Single-pass tokenizer over a memory-mapped file. Fields are separated by commas and
+// may be enclosed in double quotes, with "" for a quote inside; quoted fields can span
+// lines. Trailing carriage returns and blank lines are dropped.
+//
+// Large files are parsed by several threads. The file is cut into equal chunks, a first
+// parallel pass counts the quotes in each so every cut knows whether it falls inside a
+// quoted field, and each cut then moves forward to the next line break outside quotes.
 class CSVReader {
 public:
-  static CSV readFile(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
+  static CSV readFile(const std::string& filePath, size_t threads = std::thread::hardware_concurrency()) {
+    CSV csv;
+    csv.file = std::make_unique<MappedFile>(filePath);
+    if (!csv.file->isOpen()) {
       throw std::runtime_error("Failed to open file.");
     }
 
-    CSV lines;
-    std::string line;
-    while (std::getline(file, line)) {
-      std::istringstream iss(line);
-      CSVLine cols;
-      std::string token;
+    const char* begin = csv.file->begin();
+    const char* end = begin + csv.file->size();
+    const size_t minChunk = 1 << 20;
+    const size_t chunks = std::clamp<size_t>(csv.file->size() / minChunk, 1, std::max<size_t>(threads, 1));
 
-      while (std::getline(iss, token, ',')) {
-        cols.push_back(token);
+    std::vector<const char*> cuts(chunks + 1, end);
+    for (size_t i = 0; i < chunks; i++) {
+      cuts[i] = begin + csv.file->size() / chunks * i;
+    }
+    if (chunks > 1) {
+      std::vector<size_t> quotes(chunks);
+      parallel(chunks, [&](size_t i) { quotes[i] = std::count(cuts[i], cuts[i + 1], '"'); });
+      size_t before = 0;
+      for (size_t i = 0; i < chunks; i++) {
+        cuts[i] = nextRow(cuts[i], end, before % 2 == 1, i == 0);
+        before += quotes[i];
       }
+    }
+
+    std::vector<CSV> parts(chunks);
+    csv.unescaped.resize(chunks);
+    parallel(chunks, [&](size_t i) { parseChunk(cuts[i], std::max(cuts[i], cuts[i + 1]), parts[i], csv.unescaped[i]); });
+
+    size_t fieldCount = 0;
+    for (const CSV& part : parts) fieldCount += part.fields.size();
+    csv.fields.reserve(fieldCount);
+    for (const CSV& part : parts) {
+      const size_t offset = csv.fields.size();
+      csv.fields.insert(csv.fields.end(), part.fields.begin(), part.fields.end());
+      for (size_t r = 1; r < part.rowStarts.size(); r++) {
+        csv.rowStarts.push_back(offset + part.rowStarts[r]);
+      }
+    }
+    return csv;
+  }
+
+private:
+  template <typename F>
+  static void parallel(size_t count, F f) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+      workers.emplace_back(f, i);
+    }
+    f(0);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Start of the first row at or after p, given whether p is inside a quoted field.
+  static const char* nextRow(const char* p, const char* end, bool quoted, bool atStart) {
+    if (atStart) {
+      return p;
+    }
+    for (; p < end; ++p) {
+      if (*p == '"') quoted = !quoted;
+      else if (*p == '\n' && !quoted) return p + 1;
+    }
+    return end;
+  }
 
-      lines.push_back(cols);
+  static void parseChunk(const char* p, const char* end, CSV& part, std::deque<std::string>& storage) {
+    while (p < end) {
+      if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+        p += *p == '\n' ? 1 : 2;
+        continue;
+      }
+      p = parseRow(p, end, part.fields, storage);
+      part.rowStarts.push_back(part.fields.size());
     }
-    file.close();
+  }
 
-    return lines;
+  // Appends the fields of the row starting at p and returns the start of the next row.
+  static const char* parseRow(const char* p, const char* end, std::vector<std::string_view>& fields,
+                              std::deque<std::string>& storage) {
+    while (true) {
+      std::string_view field;
+      if (p < end && *p == '"') {
+        const char* start = ++p;
+        bool escaped = false;
+        while (p < end && (*p != '"' || (p + 1 < end && p[1] == '"'))) {
+          if (*p == '"') {
+            escaped = true;
+            ++p;
+          }
+          ++p;
+        }
+        field = std::string_view(start, p - start);
+        if (escaped) {
+          std::string& copy = storage.emplace_back();
+          for (size_t i = 0; i < field.size(); i++) {
+            copy += field[i];
+            if (field[i] == '"') i++;
+          }
+          field = copy;
+        }
+        while (p < end && *p != ',' && *p != '\n') ++p;
+      } else {
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '\n') ++p;
+        const char* stop = p > start && p[-1] == '\r' ? p - 1 : p;
+        field = std::string_view(start, stop - start);
+      }
+      fields.push_back(field);
+      if (p >= end) {
+        return end;
+      }
+      if (*p++ == '\n') {
+        return p;
+      }
+    }
   }
 };
 
@@ -64,11 +285,11 @@ struct DatasetRow {
 
 class DatasetReader {
 public:
-  static std::vector<DatasetRow> readCSV(const CSV& csv, int mode) {
+  static std::vector<DatasetRow> readCSV(const CSV& csv) {
     std::vector<DatasetRow> dataset;
     for (const auto& row : csv) {
       if (!row.empty()) {
-        Label label = row[0];
+        Label label(row[0]);
         std::vector<Attribute> attributes(row.begin() + 1, row.end());
         dataset.emplace_back(label, attributes);
       }
@@ -77,146 +298,1048 @@ public:
   }
 };
 
+// The dataset with every label and attribute value replaced by a dense id, numbered per
+// column in order of first appearance. The codes are stored one column after another.
+struct EncodedDataset {
+  size_t rows = 0;
+  size_t attributeCount = 0;
+  std::vector<Label> labelNames;
+  std::vector<uint32_t> labels;
+  // valueNames[attribute][code]
+  std::vector<std::vector<Attribute>> valueNames;
+  // codes[attribute * rows + row]
+  std::vector<uint32_t> codes;
+
+  static EncodedDataset encode(const std::vector<DatasetRow>& dataset) {
+    EncodedDataset e;
+    e.rows = dataset.size();
+    e.attributeCount = dataset.empty() ? 0 : dataset.front().attributes.size();
+    e.labels.resize(e.rows);
+    e.valueNames.resize(e.attributeCount);
+    e.codes.resize(e.attributeCount * e.rows);
+
+    std::unordered_map<std::string_view, uint32_t> labelIds;
+    std::vector<std::unordered_map<std::string_view, uint32_t>> valueIds(e.attributeCount);
+    for (size_t row = 0; row < e.rows; row++) {
+      const DatasetRow& r = dataset[row];
+      if (r.attributes.size() != e.attributeCount) {
+        throw std::runtime_error("Inconsistent attribute count.");
+      }
+      e.labels[row] = encode(r.label, labelIds, e.labelNames);
+      for (size_t i = 0; i < e.attributeCount; i++) {
+        e.codes[i * e.rows + row] = encode(r.attributes[i], valueIds[i], e.valueNames[i]);
+      }
+    }
+    return e;
+  }
+
+  const uint32_t* column(size_t attribute) const {
+    return &codes[attribute * rows];
+  }
+
+private:
+  // The keys view strings of the dataset being encoded, which outlives the maps.
+  static uint32_t encode(const std::string& value, std::unordered_map<std::string_view, uint32_t>& ids,
+                         std::vector<std::string>& names) {
+    const auto [it, inserted] = ids.try_emplace(value, (uint32_t)names.size());
+    if (inserted) {
+      names.push_back(value);
+    }
+    return it->second;
+  }
+};
+
+// The pruning the tree uses, from the mode arguments: 0 pre-pruning only, 1 post-pruning
+// only, 2 both, optionally followed by the letters of the variants to use, separate or
+// joined ("0 K", "2 NKC"). Without letters every variant of the chosen kinds is used. A
+// letter may carry its own constant instead of the default ("0 N4 K10", "1 X0.01").
+//   N - the tree is at most N levels deep.
+//   K - no split makes a leaf of fewer than K training rows.
+//   G - no split gains less than G bits of information.
+//   E - reduced error pruning on a share E of the training rows held out from growing.
+//   X - splits whose children's labels do not differ at significance level X under a
+//       chi-squared test are pruned.
+//   C - minimal cost-complexity pruning with the complexity penalty C, or one chosen by
+//       cross-validation over the training rows when C is not given.
+struct PruningOptions {
+  static constexpr size_t MAX_DEPTH = 3;
+  static constexpr size_t MIN_SAMPLES = 5;
+  static constexpr double MIN_GAIN = 0.05;
+  static constexpr double HOLDOUT = 0.25;
+  static constexpr double SIGNIFICANCE = 0.05;
+  static constexpr size_t ALPHA_FOLDS = 5;
+
+  std::optional<size_t> maxDepth;
+  std::optional<size_t> minSamples;
+  std::optional<double> minGain;
+  std::optional<double> reducedError;
+  std::optional<double> chiSquare;
+  bool costComplexity = false;
+  std::optional<double> alpha;
+
+  // Forest trees take only the variants given: they are not pre-pruned by default and
+  // never post-pruned.
+  static PruningOptions parse(const std::vector<std::string>& args, bool forest = false) {
+    const int mode = args.empty() ? 0 : std::stoi(args[0]);
+    if (mode < 0 || mode > 2) {
+      throw std::invalid_argument("Mode must be 0, 1 or 2.");
+    }
+    if (forest && mode == 1) {
+      throw std::invalid_argument("Forest trees are not post-pruned.");
+    }
+    const bool pre = mode != 1, post = mode != 0;
+
+    std::string variants;
+    for (size_t i = 1; i < args.size(); i++) {
+      variants += args[i];
+    }
+    if (variants.empty() && !forest) {
+      variants = std::string(pre ? "NKG" : "") + (post ? "EXC" : "");
+    }
+
+    PruningOptions options;
+    for (size_t i = 0; i < variants.size();) {
+      const char variant = variants[i++];
+      const size_t valueStart = i;
+      while (i < variants.size() && (std::isdigit((unsigned char)variants[i]) || variants[i] == '.')) {
+        i++;
+      }
+      const std::string value = variants.substr(valueStart, i - valueStart);
+      if (variant == 'N' && pre) {
+        options.maxDepth = value.empty() ? MAX_DEPTH : std::stoul(value);
+      } else if (variant == 'K' && pre) {
+        options.minSamples = value.empty() ? MIN_SAMPLES : std::stoul(value);
+      } else if (variant == 'G' && pre) {
+        options.minGain = value.empty() ? MIN_GAIN : std::stod(value);
+      } else if (variant == 'E' && post) {
+        options.reducedError = value.empty() ? HOLDOUT : std::stod(value);
+      } else if (variant == 'X' && post) {
+        options.chiSquare = value.empty() ? SIGNIFICANCE : std::stod(value);
+      } else if (variant == 'C' && post) {
+        options.costComplexity = true;
+        if (!value.empty()) {
+          options.alpha = std::stod(value);
+        }
+      } else {
+        throw std::invalid_argument(std::string("Unknown pruning variant ") + variant + " for mode " + args[0] + ".");
+      }
+    }
+    if (forest && options.postPruning()) {
+      throw std::invalid_argument("Forest trees are not post-pruned.");
+    }
+    return options;
+  }
+
+  bool prePruning() const {
+    return maxDepth || minSamples || minGain;
+  }
+
+  bool postPruning() const {
+    return reducedError || chiSquare || costComplexity;
+  }
+};
+
+// Upper tail probability of the chi-squared distribution with df degrees of freedom at
+// x, through the regularized incomplete gamma function: its series below a + 1 and its
+// continued fraction above.
+static double chiSquarePValue(double x, size_t df) {
+  if (x <= 0 || df == 0) {
+    return 1.0;
+  }
+  const double a = df / 2.0, y = x / 2.0;
+  const double scale = std::exp(-y + a * std::log(y) - std::lgamma(a));
+  if (y < a + 1) {
+    double term = 1.0 / a, sum = term;
+    for (int n = 1; n < 1000 && term > sum * 1e-15; n++) {
+      term *= y / (a + n);
+      sum += term;
+    }
+    return std::max(0.0, 1.0 - sum * scale);
+  }
+
+  const double tiny = 1e-300;
+  double b = y + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+  for (int i = 1; i < 1000; i++) {
+    const double an = -i * (i - a);
+    b += 2;
+    d = an * d + b;
+    d = std::abs(d) < tiny ? tiny : d;
+    c = b + an / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    d = 1 / d;
+    h *= d * c;
+    if (std::abs(d * c - 1) < 1e-15) {
+      break;
+    }
+  }
+  return scale * h;
+}
+
+// Trees are stored flat. Nodes sit in one array, each parent before its children, and
+// every internal node owns a slice of a child table with one entry per value id of its
+// attribute. Walking a row costs one table lookup per level. Values are integer ids
+// from the training dictionary; a value the node's training rows did not have ends the
+// walk there with the node's majority label.
 class ID3DecisionTree {
+public:
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  // What a build did: the nodes it grew, how many attribute gains it computed and the
+  // size of the tree left after post-pruning.
+  struct BuildStats {
+    size_t grownNodes = 0;
+    size_t nodes = 0;
+    size_t leaves = 0;
+    size_t depth = 0;
+    size_t gainEvaluations = 0;
+    std::optional<double> alpha;
+  };
+
 private:
   struct Node {
-    std::optional<size_t> attrIndex;
-    std::optional<Attribute> attrValue;
-    std::unordered_map<Label, size_t> results;
-    std::vector<std::shared_ptr<Node>> children;
+    uint32_t attribute = NONE;  // NONE at a leaf
+    uint32_t values = 0;        // number of value ids of the attribute
+    uint32_t children = 0;      // first child table entry
+    uint32_t label = 0;         // majority label
+  };
+
+  // Grows the tree over one array of row indices into an EncodedDataset. Every node owns
+  // a contiguous range of the array. One pass over the range counts a class-by-value
+  // histogram of every candidate attribute, which gives the gain of all of them; the
+  // range is then partitioned by the value of the best attribute so that every child
+  // owns a sub-range. Rows are never copied.
+  //
+  // For a forest, a row may count several times (weights[row], indexed by row id) and
+  // each split may be chosen among a random subset of the remaining attributes.
+  class Builder {
+  private:
+    ID3DecisionTree& tree;
+    const EncodedDataset& data;
+    std::vector<uint32_t>& rows;
+    std::span<const uint32_t> weights;
+    const size_t attributesPerSplit;
+    std::mt19937_64* rng;
+    std::vector<uint32_t> scratch;
+    const size_t classes;
+    // offsets[attribute]: first histogram cell of the attribute's values.
+    std::vector<size_t> offsets;
+    // histogram[(offsets[attribute] + code) * classes + label]
+    std::vector<size_t> histogram;
+
+  public:
+    Builder(ID3DecisionTree& tree, const EncodedDataset& data, std::vector<uint32_t>& rows,
+            std::span<const uint32_t> weights = {}, size_t attributesPerSplit = 0, std::mt19937_64* rng = nullptr)
+      : tree(tree), data(data), rows(rows), weights(weights), attributesPerSplit(attributesPerSplit), rng(rng),
+        scratch(rows.size()), classes(data.labelNames.size()) {
+      size_t cells = 0;
+      for (const std::vector<Attribute>& values : data.valueNames) {
+        offsets.push_back(cells);
+        cells += values.size();
+      }
+      histogram.resize(cells * classes);
+    }
+
+    // Returns the index of the new node.
+    uint32_t build(size_t begin, size_t end, const std::vector<size_t>& attrIndices, size_t depth = 0) {
+      const uint32_t index = tree.nodes.size();
+      tree.nodes.emplace_back();
+      tree.stats.nodes++;
+      tree.stats.depth = std::max(tree.stats.depth, depth);
+      tree.counts.resize(tree.counts.size() + classes, 0);
+      size_t* labelCounts = &tree.counts[index * classes];
+      for (size_t i = begin; i < end; i++) {
+        labelCounts[data.labels[rows[i]]] += weight(rows[i]);
+      }
+      tree.nodes[index].label = std::max_element(labelCounts, labelCounts + classes) - labelCounts;
+      const size_t labelsSeen = std::count_if(labelCounts, labelCounts + classes, [](size_t c) { return c > 0; });
+      const size_t total = std::accumulate(labelCounts, labelCounts + classes, size_t(0));
+
+      // The size and depth limits are checked before any gain is computed.
+      const PruningOptions& pruning = tree.pruning;
+      const bool tooDeep = pruning.maxDepth && depth >= pruning.maxDepth.value();
+      const bool tooSmall = pruning.minSamples && total < 2 * pruning.minSamples.value();
+      std::optional<size_t> bestAttrIndex;
+      if (labelsSeen == 1 || attrIndices.empty() || tooDeep || tooSmall ||
+          !(bestAttrIndex = findBestAttrIndex(begin, end, index, candidates(attrIndices)))) {
+        tree.stats.leaves++;
+        return index;
+      }
+      const size_t best = bestAttrIndex.value();
+      const uint32_t* column = data.column(best);
+      const size_t valueCount = data.valueNames[best].size();
+      const uint32_t childTable = tree.children.size();
+      tree.nodes[index].attribute = best;
+      tree.nodes[index].values = valueCount;
+      tree.nodes[index].children = childTable;
+      tree.children.resize(childTable + valueCount, NONE);
+
+      // Counting sort of the range by the value of the best attribute.
+      std::vector<size_t> starts(valueCount + 1, 0);
+      for (size_t i = begin; i < end; i++) {
+        starts[column[rows[i]] + 1]++;
+      }
+      std::partial_sum(starts.begin(), starts.end(), starts.begin());
+      std::vector<size_t> next(starts.begin(), starts.end() - 1);
+      for (size_t i = begin; i < end; i++) {
+        scratch[begin + next[column[rows[i]]]++] = rows[i];
+      }
+      std::copy(scratch.begin() + begin, scratch.begin() + end, rows.begin() + begin);
+
+      std::vector<size_t> attrIndicesNew;
+      std::copy_if(
+        attrIndices.begin(),
+        attrIndices.end(),
+        std::back_inserter(attrIndicesNew),
+        [&](const auto& x){ return x != best; }
+      );
+
+      for (size_t value = 0; value < valueCount; value++) {
+        if (starts[value] != starts[value + 1]) {
+          const uint32_t child = build(begin + starts[value], begin + starts[value + 1], attrIndicesNew, depth + 1);
+          tree.children[childTable + value] = child;
+        }
+      }
+      return index;
+    }
 
-    Node(const std::unordered_map<Label, size_t>& results)
-      : results(results) {
+  private:
+    uint32_t weight(uint32_t row) const {
+      return weights.empty() ? 1 : weights[row];
     }
 
-    Node(const size_t attrIndex)
-      : attrIndex(attrIndex) {
+    // The attributes a split may use: all of them, or a random subset in their order.
+    std::vector<size_t> candidates(const std::vector<size_t>& attrIndices) {
+      if (!rng || attributesPerSplit == 0 || attributesPerSplit >= attrIndices.size()) {
+        return attrIndices;
+      }
+      std::vector<size_t> subset = attrIndices;
+      for (size_t i = 0; i < attributesPerSplit; i++) {
+        std::uniform_int_distribution<size_t> pick(i, subset.size() - 1);
+        std::swap(subset[i], subset[pick(*rng)]);
+      }
+      subset.resize(attributesPerSplit);
+      std::sort(subset.begin(), subset.end());
+      return subset;
+    }
+
+    // The attribute of the highest gain above the minimum; with a minimum leaf size only
+    // attributes that leave no smaller child take part.
+    std::optional<size_t> findBestAttrIndex(size_t begin, size_t end, uint32_t node,
+                                            const std::vector<size_t>& attrIndices) {
+      const size_t minSamples = tree.pruning.minSamples.value_or(1);
+      tree.stats.gainEvaluations += attrIndices.size();
+      for (const size_t attrIndex : attrIndices) {
+        const uint32_t* column = data.column(attrIndex);
+        size_t* cells = &histogram[offsets[attrIndex] * classes];
+        std::fill(cells, cells + data.valueNames[attrIndex].size() * classes, 0);
+        for (size_t i = begin; i < end; i++) {
+          const uint32_t row = rows[i];
+          cells[column[row] * classes + data.labels[row]] += weight(row);
+        }
+      }
+
+      const size_t* nodeCounts = &tree.counts[node * classes];
+      const size_t total = std::accumulate(nodeCounts, nodeCounts + classes, size_t(0));
+      const double baseEntropy = calculateEntropy(&tree.counts[node * classes], classes, total);
+      std::optional<size_t> bestAttrIndex;
+      double bestGain = 0.0;
+      for (const size_t attrIndex : attrIndices) {
+        const size_t* cells = &histogram[offsets[attrIndex] * classes];
+        double weightedEntropy = 0;
+        bool allowed = true;
+        for (size_t value = 0; value < data.valueNames[attrIndex].size(); value++) {
+          const size_t* counts = cells + value * classes;
+          const size_t subset = std::accumulate(counts, counts + classes, size_t(0));
+          if (subset) {
+            weightedEntropy += (double)subset / total * calculateEntropy(counts, classes, subset);
+            allowed = allowed && subset >= minSamples;
+          }
+        }
+
+        const double gain = baseEntropy - weightedEntropy;
+        if (allowed && gain > bestGain && gain >= tree.pruning.minGain.value_or(0.0)) {
+          bestGain = gain;
+          bestAttrIndex = attrIndex;
+        }
+      }
+      return bestAttrIndex;
+    }
+
+    static double calculateEntropy(const size_t* counts, size_t classes, size_t total) {
+      double entropy = 0;
+      for (size_t label = 0; label < classes; label++) {
+        if (counts[label]) {
+          double prob = (double)counts[label] / total;
+          entropy -= prob * std::log2(prob);
+        }
+      }
+      return entropy;
     }
   };
 
-  std::shared_ptr<Node> root;
+  // Rows of a batch that go down the tree together.
+  static constexpr size_t BLOCK = 256;
+
+  std::vector<Node> nodes;
+  // children[node.children + value] is the child for that value id, or NONE.
+  std::vector<uint32_t> children;
+  // counts[node * labelNames.size() + label]: training rows of each label at the node.
+  std::vector<size_t> counts;
+  std::vector<Label> labelNames;
+  std::vector<std::unordered_map<Attribute, uint32_t>> valueIds;
+  PruningOptions pruning;
+  BuildStats stats;
 
 public:
+  ID3DecisionTree(const PruningOptions& pruning = {})
+    : pruning(pruning) {
+  }
+
   void train(const std::vector<DatasetRow>& data) {
-    root = nullptr;
-    if (data.empty()) {
+    train(EncodedDataset::encode(data));
+  }
+
+  void train(const EncodedDataset& data) {
+    std::vector<uint32_t> rows(data.rows);
+    std::iota(rows.begin(), rows.end(), 0);
+    train(data, std::move(rows));
+  }
+
+  // Trains on the given rows of data only. Post-pruning runs over the grown tree in the
+  // order X, C, E, and the tree is compacted after growing and after every pass.
+  void train(const EncodedDataset& data, std::vector<uint32_t> rows) {
+    reset(data);
+    if (rows.empty()) {
       return;
     }
 
-    std::vector<size_t> attrIndices(data[0].attributes.size());
+    std::vector<uint32_t> holdout;
+    if (pruning.reducedError) {
+      std::shuffle(rows.begin(), rows.end(), rnde);
+      const size_t held = std::min<size_t>(pruning.reducedError.value() * rows.size(), rows.size() - 1);
+      holdout.assign(rows.end() - held, rows.end());
+      rows.resize(rows.size() - held);
+    }
+
+    std::vector<size_t> attrIndices(data.attributeCount);
     std::iota(attrIndices.begin(), attrIndices.end(), 0);
-    root = buildTree(data, attrIndices);
+    Builder(*this, data, rows).build(0, rows.size(), attrIndices);
+    stats.grownNodes = nodes.size();
+    compact();
+
+    if (pruning.chiSquare) {
+      pruneChiSquare(pruning.chiSquare.value());
+      compact();
+    }
+    if (pruning.costComplexity) {
+      stats.alpha = pruning.alpha ? pruning.alpha.value() : chooseAlpha(data, rows);
+      pruneCostComplexity(stats.alpha.value());
+      compact();
+    }
+    if (!holdout.empty()) {
+      pruneReducedError(data, holdout);
+      compact();
+    }
+  }
+
+  // Grows a tree of a forest: row r of rows counts weights[r] times and every split is
+  // chosen among attributesPerSplit attributes drawn with rng. Only pre-pruning applies.
+  void train(const EncodedDataset& data, std::vector<uint32_t> rows, std::span<const uint32_t> weights,
+             size_t attributesPerSplit, std::mt19937_64& rng) {
+    reset(data);
+    if (rows.empty()) {
+      return;
+    }
+
+    std::vector<size_t> attrIndices(data.attributeCount);
+    std::iota(attrIndices.begin(), attrIndices.end(), 0);
+    Builder(*this, data, rows, weights, attributesPerSplit, &rng).build(0, rows.size(), attrIndices);
+    stats.grownNodes = nodes.size();
+    compact();
+  }
+
+  // Reduced error pruning: bottom-up, a node becomes a leaf when that makes no more
+  // mistakes on the given rows than its subtree does. Rows that stop at a node for want
+  // of a child count against the node's label either way.
+  void pruneReducedError(const EncodedDataset& data, std::span<const uint32_t> rows) {
+    const size_t classes = labelNames.size();
+    std::vector<size_t> reached(nodes.size() * classes, 0);
+    for (const uint32_t row : rows) {
+      walk(data, row, [&](uint32_t node) { reached[node * classes + data.labels[row]]++; });
+    }
+
+    std::vector<size_t> errors(nodes.size(), 0);
+    for (size_t node = nodes.size(); node-- > 0;) {
+      const size_t* here = &reached[node * classes];
+      const size_t total = std::accumulate(here, here + classes, size_t(0));
+      const size_t leafErrors = total - here[nodes[node].label];
+      if (nodes[node].attribute == NONE) {
+        errors[node] = leafErrors;
+        continue;
+      }
+
+      // Rows that stopped here are the ones no child received.
+      std::vector<size_t> stopped(here, here + classes);
+      size_t subtreeErrors = 0;
+      forEachChild(node, [&](uint32_t child) {
+        subtreeErrors += errors[child];
+        for (size_t label = 0; label < classes; label++) {
+          stopped[label] -= reached[child * classes + label];
+        }
+      });
+      subtreeErrors += std::accumulate(stopped.begin(), stopped.end(), size_t(0)) - stopped[nodes[node].label];
+
+      if (leafErrors <= subtreeErrors) {
+        nodes[node].attribute = NONE;
+        errors[node] = leafErrors;
+      } else {
+        errors[node] = subtreeErrors;
+      }
+    }
+  }
+
+  // Bottom-up, a node whose children are all leaves becomes a leaf when the training
+  // labels of its children do not differ from the node's own label distribution at the
+  // given significance level.
+  void pruneChiSquare(double significance) {
+    const size_t classes = labelNames.size();
+    for (size_t node = nodes.size(); node-- > 0;) {
+      if (nodes[node].attribute == NONE) {
+        continue;
+      }
+      bool leavesOnly = true;
+      size_t branches = 0;
+      forEachChild(node, [&](uint32_t child) {
+        leavesOnly = leavesOnly && nodes[child].attribute == NONE;
+        branches++;
+      });
+      if (!leavesOnly) {
+        continue;
+      }
+
+      const size_t* parent = &counts[node * classes];
+      const size_t total = std::accumulate(parent, parent + classes, size_t(0));
+      const size_t labelsSeen = std::count_if(parent, parent + classes, [](size_t c) { return c > 0; });
+      double statistic = 0.0;
+      forEachChild(node, [&](uint32_t child) {
+        const size_t* observed = &counts[child * classes];
+        const size_t childTotal = std::accumulate(observed, observed + classes, size_t(0));
+        for (size_t label = 0; label < classes; label++) {
+          if (parent[label]) {
+            const double expected = (double)childTotal * parent[label] / total;
+            statistic += std::pow(observed[label] - expected, 2) / expected;
+          }
+        }
+      });
+
+      if (chiSquarePValue(statistic, (branches - 1) * (labelsSeen - 1)) > significance) {
+        nodes[node].attribute = NONE;
+      }
+    }
+  }
+
+  // Weakest-link pruning computed for every complexity penalty at once. With R(t) the
+  // share of training rows misclassified by node t as a leaf and T_t its subtree, the
+  // node that goes first is the one of least (R(t) - R(T_t)) / (leaves(T_t) - 1); once
+  // it is a leaf the totals of its ancestors change and the next one goes. The result
+  // holds for every internal node the penalty at which it becomes a leaf, and infinity
+  // for leaves, so pruning at any alpha keeps the nodes whose value is above it.
+  std::vector<double> collapseAlphas() const {
+    const size_t classes = labelNames.size();
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double rows = std::accumulate(counts.begin(), counts.begin() + classes, size_t(0));
+
+    std::vector<uint32_t> parents(nodes.size(), NONE);
+    std::vector<double> leafError(nodes.size()), subtreeError(nodes.size());
+    std::vector<size_t> leaves(nodes.size());
+    for (size_t node = nodes.size(); node-- > 0;) {
+      const size_t* here = &counts[node * classes];
+      leafError[node] = (std::accumulate(here, here + classes, size_t(0)) - here[nodes[node].label]) / rows;
+      if (nodes[node].attribute == NONE) {
+        subtreeError[node] = leafError[node];
+        leaves[node] = 1;
+        continue;
+      }
+      forEachChild(node, [&](uint32_t child) {
+        parents[child] = node;
+        subtreeError[node] += subtreeError[child];
+        leaves[node] += leaves[child];
+      });
+    }
+
+    // Entries go stale when a descendant collapses; version tells the current one.
+    using Candidate = std::tuple<double, uint32_t, uint32_t>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+    std::vector<uint32_t> version(nodes.size(), 0);
+    const auto push = [&](uint32_t node) {
+      const double link = (leafError[node] - subtreeError[node]) / (leaves[node] - 1);
+      queue.emplace(link, node, ++version[node]);
+    };
+    for (size_t node = 0; node < nodes.size(); node++) {
+      if (nodes[node].attribute != NONE) {
+        push(node);
+      }
+    }
+
+    std::vector<double> alphas(nodes.size(), infinity);
+    double alpha = 0.0;
+    while (!queue.empty()) {
+      const auto [link, node, current] = queue.top();
+      queue.pop();
+      if (current != version[node] || alphas[node] != infinity) {
+        continue;
+      }
+
+      alpha = std::max(alpha, link);
+      std::vector<uint32_t> stack{node};
+      while (!stack.empty()) {
+        const uint32_t next = stack.back();
+        stack.pop_back();
+        if (nodes[next].attribute != NONE && alphas[next] == infinity) {
+          alphas[next] = alpha;
+          forEachChild(next, [&](uint32_t child) { stack.push_back(child); });
+        }
+      }
+
+      const double errorDelta = leafError[node] - subtreeError[node];
+      const size_t leavesDelta = leaves[node] - 1;
+      for (uint32_t up = parents[node]; up != NONE; up = parents[up]) {
+        subtreeError[up] += errorDelta;
+        leaves[up] -= leavesDelta;
+        push(up);
+      }
+    }
+    return alphas;
+  }
+
+  void pruneCostComplexity(double alpha) {
+    const std::vector<double> alphas = collapseAlphas();
+    for (size_t node = 0; node < nodes.size(); node++) {
+      if (alphas[node] <= alpha) {
+        nodes[node].attribute = NONE;
+      }
+    }
+  }
+
+  // Rebuilds the arrays with only the nodes still reachable from the root, breadth
+  // first, and child tables cut after their last child.
+  void compact() {
+    const size_t classes = labelNames.size();
+    std::vector<Node> compactNodes;
+    std::vector<uint32_t> compactChildren;
+    std::vector<size_t> compactCounts;
+    std::vector<uint32_t> order{0};
+    std::vector<size_t> depths{0};
+    stats.nodes = stats.leaves = stats.depth = 0;
+    for (size_t i = 0; i < order.size() && !nodes.empty(); i++) {
+      Node node = nodes[order[i]];
+      compactCounts.insert(compactCounts.end(), &counts[order[i] * classes], &counts[(order[i] + 1) * classes]);
+      stats.depth = std::max(stats.depth, depths[i]);
+      if (node.attribute == NONE) {
+        node.values = node.children = 0;
+        stats.leaves++;
+      } else {
+        const uint32_t table = compactChildren.size();
+        uint32_t values = 0;
+        for (uint32_t value = 0; value < node.values; value++) {
+          const uint32_t child = children[node.children + value];
+          if (child == NONE) {
+            compactChildren.push_back(NONE);
+            continue;
+          }
+          compactChildren.push_back(order.size());
+          order.push_back(child);
+          depths.push_back(depths[i] + 1);
+          values = value + 1;
+        }
+        compactChildren.resize(table + values);
+        node.values = values;
+        node.children = table;
+      }
+      compactNodes.push_back(node);
+    }
+    stats.nodes = compactNodes.size();
+
+    nodes = std::move(compactNodes);
+    children = std::move(compactChildren);
+    counts = std::move(compactCounts);
+  }
+
+  const BuildStats& getStats() const {
+    return stats;
+  }
+
+  // The label id of a row of the dataset the tree was trained on.
+  uint32_t predict(const EncodedDataset& data, uint32_t row) const {
+    uint32_t stop = 0;
+    walk(data, row, [&](uint32_t node) { stop = node; });
+    return nodes[stop].label;
+  }
+
+  const std::vector<Label>& getLabelNames() const {
+    return labelNames;
+  }
+
+  size_t getAttributeCount() const {
+    return valueIds.size();
   }
 
   Label predict(const std::vector<Attribute>& attributes) const {
-    if (!root) {
+    std::vector<uint32_t> labels;
+    predict(encode(attributes), labels);
+    return labelNames[labels[0]];
+  }
+
+  std::vector<Label> predict(const std::vector<DatasetRow>& rows) const {
+    std::vector<uint32_t> codes;
+    for (const DatasetRow& row : rows) {
+      const std::vector<uint32_t> rowCodes = encode(row.attributes);
+      codes.insert(codes.end(), rowCodes.begin(), rowCodes.end());
+    }
+
+    std::vector<uint32_t> labels;
+    predict(codes, labels);
+    std::vector<Label> predictions;
+    for (const uint32_t label : labels) {
+      predictions.push_back(labelNames[label]);
+    }
+    return predictions;
+  }
+
+  // Predicts the label ids of rows of value ids, one row after another, BLOCK rows at a
+  // time. The rows of a block go down the tree together, one level per pass, so the
+  // node loads of different rows do not wait on each other.
+  void predict(std::span<const uint32_t> codes, std::vector<uint32_t>& labels) const {
+    if (nodes.empty()) {
       throw std::runtime_error("Tree is not trained.");
     }
 
-    auto node = root;
-    while (node->results.empty()) {
-      Attribute attrValue = attributes[node->attrIndex.value()];
-      auto it = std::find_if(node->children.begin(), node->children.end(), [&](const auto& n) { return n->attrValue == attrValue; });
-      if (it == node->children.end()) {
-        throw std::runtime_error("No matching branch.");
+    const size_t attributeCount = valueIds.size();
+    const size_t rowCount = attributeCount ? codes.size() / attributeCount : 0;
+    labels.resize(rowCount);
+    std::array<uint32_t, BLOCK> at, active;
+    for (size_t first = 0; first < rowCount; first += BLOCK) {
+      size_t live = std::min(BLOCK, rowCount - first);
+      for (size_t i = 0; i < live; i++) {
+        at[i] = 0;
+        active[i] = i;
+      }
+
+      while (live) {
+        size_t kept = 0;
+        for (size_t k = 0; k < live; k++) {
+          const uint32_t i = active[k];
+          const Node& node = nodes[at[i]];
+          uint32_t next = NONE;
+          if (node.attribute != NONE) {
+            const uint32_t value = codes[(first + i) * attributeCount + node.attribute];
+            next = value < node.values ? children[node.children + value] : NONE;
+          }
+          if (next == NONE) {
+            labels[first + i] = node.label;
+          } else {
+            at[i] = next;
+            active[kept++] = i;
+          }
+        }
+        live = kept;
       }
-      node = *it;
     }
+  }
 
-    return std::max_element(
-      node->results.begin(),
-      node->results.end(),
-      [](const auto& a, const auto& b) { return a.second < b.second; }
-    )->first;
+  // The value ids of a row, NONE for values never seen in training.
+  std::vector<uint32_t> encode(const std::vector<Attribute>& attributes) const {
+    if (attributes.size() != valueIds.size()) {
+      throw std::invalid_argument("Attribute count does not match the tree.");
+    }
+    std::vector<uint32_t> codes(attributes.size());
+    for (size_t i = 0; i < attributes.size(); i++) {
+      const auto it = valueIds[i].find(attributes[i]);
+      codes[i] = it == valueIds[i].end() ? NONE : it->second;
+    }
+    return codes;
   }
 
 private:
-  static std::shared_ptr<Node> buildTree(const std::vector<DatasetRow>& data, const std::vector<size_t>& attrIndices) {
-    std::vector<Label> labels;
-    std::transform(data.begin(), data.end(), std::back_inserter(labels), DatasetRow::labelSelector);
-    std::unordered_set labelsSet(labels.begin(), labels.end());
+  void reset(const EncodedDataset& data) {
+    nodes.clear();
+    children.clear();
+    counts.clear();
+    stats = {};
+    labelNames = data.labelNames;
+    valueIds.assign(data.attributeCount, {});
+    for (size_t i = 0; i < data.attributeCount; i++) {
+      for (size_t value = 0; value < data.valueNames[i].size(); value++) {
+        valueIds[i].emplace(data.valueNames[i][value], value);
+      }
+    }
+  }
 
-    std::optional<size_t> bestAttrIndex;
-    if (labelsSet.size() == 1 || attrIndices.empty() || !(bestAttrIndex = findeBestAttrIndex(data, attrIndices))) {
-      std::unordered_map<Label, size_t> results;
-      for (const Label& label : labelsSet) {
-        results[label] = std::count(labels.begin(), labels.end(), label);
+  template <typename F>
+  void forEachChild(size_t node, F f) const {
+    for (uint32_t value = 0; value < nodes[node].values; value++) {
+      const uint32_t child = children[nodes[node].children + value];
+      if (child != NONE) {
+        f(child);
       }
-      return std::make_shared<Node>(results);
     }
+  }
 
-    auto root = std::make_shared<Node>(bestAttrIndex.value());
-    auto splits = splitData(data, bestAttrIndex.value());
-    for (const auto& [value, subset] : splits) {
-      std::vector<size_t> attrIndicesNew;
-      std::copy_if(
-        attrIndices.begin(),
-        attrIndices.end(),
-        std::back_inserter(attrIndicesNew),
-        [&](const auto& x){ return x != bestAttrIndex; }
-      );
+  // Calls visit with every node from the root to where the row stops.
+  template <typename F>
+  void walk(const EncodedDataset& data, uint32_t row, F visit) const {
+    uint32_t node = 0;
+    while (true) {
+      visit(node);
+      const Node& n = nodes[node];
+      if (n.attribute == NONE) {
+        return;
+      }
+      const uint32_t value = data.column(n.attribute)[row];
+      const uint32_t next = value < n.values ? children[n.children + value] : NONE;
+      if (next == NONE) {
+        return;
+      }
+      node = next;
+    }
+  }
 
-      auto child = buildTree(data, attrIndicesNew);
-      child->attrValue = value;
+  // The penalty of least cross-validated error on the given rows. The candidates are
+  // the geometric means of consecutive penalties on this tree's path. Every fold tree
+  // is grown once with the same pre-pruning and chi-squared pruning; its own path then
+  // gives its errors under every candidate from a single walk per held-out row.
+  double chooseAlpha(const EncodedDataset& data, std::vector<uint32_t> rows) const {
+    std::vector<double> path = collapseAlphas();
+    path.erase(std::remove(path.begin(), path.end(), std::numeric_limits<double>::infinity()), path.end());
+    std::sort(path.begin(), path.end());
+    path.erase(std::unique(path.begin(), path.end()), path.end());
+    if (path.empty() || rows.size() < PruningOptions::ALPHA_FOLDS) {
+      return 0.0;
+    }
+    std::vector<double> candidates{0.0};
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+      candidates.push_back(std::sqrt(path[i] * path[i + 1]));
+    }
+    candidates.push_back(path.back());
+
+    PruningOptions foldPruning = pruning;
+    foldPruning.reducedError.reset();
+    foldPruning.costComplexity = false;
+    std::shuffle(rows.begin(), rows.end(), rnde);
+    std::vector<ptrdiff_t> errorDelta(candidates.size() + 1, 0);
+    for (size_t fold = 0; fold < PruningOptions::ALPHA_FOLDS; fold++) {
+      std::vector<uint32_t> train, test;
+      for (size_t i = 0; i < rows.size(); i++) {
+        (i % PruningOptions::ALPHA_FOLDS == fold ? test : train).push_back(rows[i]);
+      }
+      ID3DecisionTree tree(foldPruning);
+      tree.train(data, train);
+      // firstCandidate[node]: the first candidate at which the fold tree's node is a leaf.
+      const std::vector<double> alphas = tree.collapseAlphas();
+      std::vector<size_t> firstCandidate(alphas.size());
+      for (size_t node = 0; node < alphas.size(); node++) {
+        firstCandidate[node] = std::lower_bound(candidates.begin(), candidates.end(), alphas[node]) - candidates.begin();
+      }
 
-      root->children.push_back(child);
+      // Penalties only grow towards the root, so the row stops at the i-th node of its
+      // path for the candidates in [alphas[path[i]], alphas[path[i - 1]]); the last node
+      // takes every candidate below that. Each range is added once to a difference array.
+      std::vector<uint32_t> visited;
+      for (const uint32_t row : test) {
+        visited.clear();
+        tree.walk(data, row, [&](uint32_t node) { visited.push_back(node); });
+        size_t upper = candidates.size();
+        for (size_t i = 0; i < visited.size() && upper > 0; i++) {
+          const size_t lower = i + 1 == visited.size() ? 0 : firstCandidate[visited[i]];
+          if (lower < upper && tree.nodes[visited[i]].label != data.labels[row]) {
+            errorDelta[lower]++;
+            errorDelta[upper]--;
+          }
+          upper = std::min(upper, lower);
+        }
+      }
+    }
+    std::vector<size_t> errors(candidates.size());
+    ptrdiff_t running = 0;
+    for (size_t c = 0; c < candidates.size(); c++) {
+      running += errorDelta[c];
+      errors[c] = running;
     }
 
-    return root;
+    // Ties go to the larger penalty, the smaller tree.
+    size_t best = 0;
+    for (size_t c = 1; c < candidates.size(); c++) {
+      if (errors[c] <= errors[best]) {
+        best = c;
+      }
+    }
+    return candidates[best];
   }
+};
 
-  static std::optional<size_t> findeBestAttrIndex(const std::vector<DatasetRow>& data, const std::vector<size_t>& attrIndices) {
-    std::optional<size_t> bestAttrIndex;
-    double bestGain = 0.0;
+// Random Forest of ID3 trees. Every tree grows on its own bootstrap sample, kept as the
+// distinct rows drawn and a weight per row that says how many times it was drawn, and
+// chooses each split among a random subset of the attributes. Trees grow in parallel.
+// Tree t draws from an engine seeded with the forest seed and t, so the forest does not
+// depend on the number of threads. The rows a tree did not draw vote on the
+// out-of-bag accuracy.
+class RandomForest {
+private:
+  // Rows scored together by every tree before the next chunk.
+  static constexpr size_t CHUNK = 4096;
 
-    for (const size_t attrIndex : attrIndices) {
-      double gain = calculateGain(data, attrIndex);
-      if (gain > bestGain) {
-        bestGain = gain;
-        bestAttrIndex = attrIndex;
-      }
+  size_t treeCount;
+  PruningOptions pruning;
+  size_t threads;
+  uint64_t seed;
+  std::vector<ID3DecisionTree> trees;
+  double oobAccuracy = 0.0;
+
+public:
+  // Forest trees may be pre-pruned but not post-pruned.
+  RandomForest(size_t treeCount, const PruningOptions& pruning, uint64_t seed,
+               size_t threads = std::thread::hardware_concurrency())
+    : treeCount(std::max<size_t>(treeCount, 1)), pruning(pruning), threads(std::max<size_t>(threads, 1)), seed(seed) {
+    if (pruning.postPruning()) {
+      throw std::invalid_argument("Forest trees are not post-pruned.");
     }
+  }
 
-    return bestAttrIndex;
+  void train(const std::vector<DatasetRow>& data) {
+    train(EncodedDataset::encode(data));
   }
 
-  static double calculateGain(const std::vector<DatasetRow>& data, const size_t attrIndex) {
-    double base_entropy = calculateEntropy(data);
-    size_t total_samples = data.size();
+  // Each split considers the rounded square root of the attribute count.
+  void train(const EncodedDataset& data) {
+    if (data.rows == 0) {
+      throw std::invalid_argument("No rows to train on.");
+    }
+    const size_t classes = data.labelNames.size();
+    const size_t attributesPerSplit = std::max<size_t>(std::lround(std::sqrt((double)data.attributeCount)), 1);
+    trees.assign(treeCount, ID3DecisionTree(pruning));
+    std::vector<std::atomic<uint32_t>> oobVotes(data.rows * classes);
 
-    auto splits = splitData(data, attrIndex);
-    double weighted_entropy = 0;
-    for (const auto& [_, subset] : splits) {
-      double prob = (double)subset.size() / total_samples;
-      weighted_entropy += prob * calculateEntropy(subset);
+    parallel(treeCount, [&](size_t t) {
+      std::mt19937_64 rng = engine(t);
+      std::uniform_int_distribution<uint32_t> pick(0, data.rows - 1);
+      std::vector<uint32_t> weights(data.rows, 0);
+      for (size_t i = 0; i < data.rows; i++) {
+        weights[pick(rng)]++;
+      }
+      std::vector<uint32_t> rows;
+      for (uint32_t row = 0; row < data.rows; row++) {
+        if (weights[row]) {
+          rows.push_back(row);
+        }
+      }
+
+      trees[t].train(data, rows, weights, attributesPerSplit, rng);
+      for (uint32_t row = 0; row < data.rows; row++) {
+        if (!weights[row]) {
+          oobVotes[row * classes + trees[t].predict(data, row)].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+
+    size_t voted = 0, correct = 0;
+    for (size_t row = 0; row < data.rows; row++) {
+      const auto first = oobVotes.begin() + row * classes;
+      const auto best = std::max_element(first, first + classes, [](const auto& a, const auto& b) { return a.load() < b.load(); });
+      if (best->load()) {
+        voted++;
+        correct += (size_t)(best - first) == data.labels[row];
+      }
     }
+    oobAccuracy = voted ? (double)correct / voted : 0.0;
+  }
 
-    return base_entropy - weighted_entropy;
+  // Share of training rows predicted right by the trees that did not draw them, over the
+  // rows that at least one tree left out.
+  double getOobAccuracy() const {
+    return oobAccuracy;
   }
 
-  static double calculateEntropy(const std::vector<DatasetRow>& data) {
-    size_t total = data.size();
-    std::unordered_map<Label, size_t> labelCounts;
+  size_t getNodes() const {
+    size_t nodes = 0;
+    for (const ID3DecisionTree& tree : trees) {
+      nodes += tree.getStats().nodes;
+    }
+    return nodes;
+  }
 
-    for (const auto& row : data) {
-      labelCounts[row.label] += 1;
+  std::vector<Label> predict(const std::vector<DatasetRow>& rows) const {
+    std::vector<uint32_t> codes;
+    for (const DatasetRow& row : rows) {
+      const std::vector<uint32_t> rowCodes = trees.front().encode(row.attributes);
+      codes.insert(codes.end(), rowCodes.begin(), rowCodes.end());
     }
 
-    double entropy = 0;
-    for (const auto& [_, count] : labelCounts) {
-      double prob = (double)count / total;
-      entropy -= prob * std::log2(prob);
+    std::vector<uint32_t> labels;
+    predict(codes, labels);
+    std::vector<Label> predictions;
+    for (const uint32_t label : labels) {
+      predictions.push_back(trees.front().getLabelNames()[label]);
     }
-    return entropy;
+    return predictions;
   }
 
-  static std::unordered_map<Attribute, std::vector<DatasetRow>> splitData(const std::vector<DatasetRow>& data, const size_t bestAttrIndex) {
-    std::unordered_map<Attribute, std::vector<DatasetRow>> splits;
-    for (const DatasetRow& row : data) {
-      Attribute value = row.attributes[bestAttrIndex];
-      splits[value].push_back(row);
+  // Majority vote over all trees for rows of value ids, one row after another. Chunks
+  // of rows are scored in parallel, each by every tree in turn with the tree's batch
+  // walk; ties go to the lower label id.
+  void predict(std::span<const uint32_t> codes, std::vector<uint32_t>& labels) const {
+    if (trees.empty()) {
+      throw std::runtime_error("Forest is not trained.");
+    }
+
+    const size_t attributeCount = trees.front().getAttributeCount();
+    const size_t classes = trees.front().getLabelNames().size();
+    const size_t rowCount = attributeCount ? codes.size() / attributeCount : 0;
+    labels.resize(rowCount);
+    parallel((rowCount + CHUNK - 1) / CHUNK, [&](size_t chunk) {
+      const size_t first = chunk * CHUNK, count = std::min(CHUNK, rowCount - first);
+      const std::span<const uint32_t> rows = codes.subspan(first * attributeCount, count * attributeCount);
+      std::vector<uint32_t> votes(count * classes, 0), treeLabels;
+      for (const ID3DecisionTree& tree : trees) {
+        tree.predict(rows, treeLabels);
+        for (size_t i = 0; i < count; i++) {
+          votes[i * classes + treeLabels[i]]++;
+        }
+      }
+      for (size_t i = 0; i < count; i++) {
+        const auto row = votes.begin() + i * classes;
+        labels[first + i] = std::max_element(row, row + classes) - row;
+      }
+    });
+  }
+
+private:
+  // splitmix64 over the seed and the tree.
+  std::mt19937_64 engine(uint64_t tree) const {
+    uint64_t z = (seed ^ tree) + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return std::mt19937_64(z ^ (z >> 31));
+  }
+
+  // Runs f(0) .. f(count - 1) on up to threads threads, each taking the next task when
+  // it is done with one.
+  template <typename F>
+  void parallel(size_t count, F f) const {
+    std::atomic<size_t> next = 0;
+    const auto work = [&] {
+      for (size_t task; (task = next++) < count;) {
+        f(task);
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, count); i++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+      worker.join();
     }
-    return splits;
   }
 };
 
@@ -246,13 +1369,30 @@ static void splitTrainTest(const std::vector<T>& dataset, const std::function<S(
   std::shuffle(test.begin(), test.end(), rnde);
 }
 
-double calculateAccuracy(const std::vector<DatasetRow>& train, const std::vector<DatasetRow>& test) {
-  ID3DecisionTree tree;
-  tree.train(train);
+// A forest of trees grows instead of a single tree when trees is not 0. The seed also
+// fixes the train/test split.
+struct ForestOptions {
+  size_t trees = 0;
+  uint64_t seed = rndd();
+  size_t threads = std::thread::hardware_concurrency();
+};
+
+double calculateAccuracy(const std::vector<DatasetRow>& train, const std::vector<DatasetRow>& test,
+                         const PruningOptions& pruning, const ForestOptions& forest) {
+  std::vector<Label> predicted;
+  if (forest.trees) {
+    RandomForest model(forest.trees, pruning, forest.seed, forest.threads);
+    model.train(train);
+    predicted = model.predict(test);
+  } else {
+    ID3DecisionTree tree(pruning);
+    tree.train(train);
+    predicted = tree.predict(test);
+  }
 
   size_t predictions = 0;
-  for (const DatasetRow& row : test) {
-    if (tree.predict(row.attributes) == row.label) {
+  for (size_t i = 0; i < test.size(); i++) {
+    if (predicted[i] == test[i].label) {
       predictions++;
     }
   }
@@ -260,7 +1400,8 @@ double calculateAccuracy(const std::vector<DatasetRow>& train, const std::vector
   return (double)(predictions) / test.size();
 }
 
-std::vector<double> calculateKFoldAccuracy(const std::vector<DatasetRow>& dataset, const size_t K, double& mean, double& stdev) {
+std::vector<double> calculateKFoldAccuracy(const std::vector<DatasetRow>& dataset, const PruningOptions& pruning,
+                                           const ForestOptions& forest, const size_t K, double& mean, double& stdev) {
   const size_t testSize = dataset.size() / K;
 
   std::vector<double> accuracies;
@@ -273,7 +1414,7 @@ std::vector<double> calculateKFoldAccuracy(const std::vector<DatasetRow>& datase
     test.insert(test.end(), dataset.begin() + testStart, dataset.begin() + testStart + testSize);
     train.insert(train.end(), dataset.begin() + testStart + testSize, dataset.end());
 
-    double accuracy = calculateAccuracy(train, test);
+    double accuracy = calculateAccuracy(train, test, pruning, forest);
     accuracies.push_back(accuracy);
   }
 
@@ -289,17 +1430,123 @@ std::vector<double> calculateKFoldAccuracy(const std::vector<DatasetRow>& datase
   return accuracies;
 }
 
-void solve(const std::vector<DatasetRow> dataset) {
+// Builds the tree of the training set once without pruning and once for every enabled
+// pre-pruning variant, alone and all together, and prints what each one saved. The
+// post-pruning variants are then applied one at a time, and all together, to the tree
+// grown with the chosen pre-pruning.
+void reportPruning(const std::vector<DatasetRow>& train, const PruningOptions& pruning) {
+  const EncodedDataset data = EncodedDataset::encode(train);
+  const auto build = [&](const PruningOptions& options) {
+    ID3DecisionTree tree(options);
+    tree.train(data);
+    return tree.getStats();
+  };
+  const auto describe = [](const ID3DecisionTree::BuildStats& stats) {
+    std::ostringstream out;
+    out << stats.nodes << " nodes (" << stats.leaves << " leaves, depth " << stats.depth << ")";
+    return out.str();
+  };
+
+  PruningOptions pre = pruning;
+  pre.reducedError.reset();
+  pre.chiSquare.reset();
+  pre.costComplexity = false;
+
+  if (pre.prePruning()) {
+    const ID3DecisionTree::BuildStats full = build({});
+    const auto print = [&](const std::string& name, const PruningOptions& options) {
+      const ID3DecisionTree::BuildStats stats = build(options);
+      std::cout << "    " << name << ": " << describe(stats) << ", " << stats.gainEvaluations
+                << " gain evaluations; saved " << full.nodes - stats.nodes << " nodes and "
+                << full.gainEvaluations - stats.gainEvaluations << " gain evaluations" << std::endl;
+    };
+
+    std::cout << "Pre-Pruning:" << std::endl
+              << "    None: " << describe(full) << ", " << full.gainEvaluations << " gain evaluations" << std::endl;
+    if (pre.maxDepth) {
+      PruningOptions options;
+      options.maxDepth = pre.maxDepth;
+      print("N = " + std::to_string(pre.maxDepth.value()), options);
+    }
+    if (pre.minSamples) {
+      PruningOptions options;
+      options.minSamples = pre.minSamples;
+      print("K = " + std::to_string(pre.minSamples.value()), options);
+    }
+    if (pre.minGain) {
+      PruningOptions options;
+      options.minGain = pre.minGain;
+      std::ostringstream name;
+      name << "G = " << pre.minGain.value();
+      print(name.str(), options);
+    }
+    if ((bool)pre.maxDepth + (bool)pre.minSamples + (bool)pre.minGain > 1) {
+      print("All", pre);
+    }
+    std::cout << std::endl;
+  }
+
+  if (pruning.postPruning()) {
+    const auto print = [&](const std::string& name, const PruningOptions& options) {
+      const ID3DecisionTree::BuildStats stats = build(options);
+      std::cout << "    " << name;
+      if (stats.alpha) {
+        std::cout << " (alpha = " << stats.alpha.value() << ")";
+      }
+      std::cout << ": grown " << stats.grownNodes << " nodes, pruned to " << describe(stats) << std::endl;
+    };
+
+    std::cout << "Post-Pruning:" << std::endl;
+    if (pruning.reducedError) {
+      PruningOptions options = pre;
+      options.reducedError = pruning.reducedError;
+      std::ostringstream name;
+      name << "E (" << pruning.reducedError.value() * 100 << "% held out)";
+      print(name.str(), options);
+    }
+    if (pruning.chiSquare) {
+      PruningOptions options = pre;
+      options.chiSquare = pruning.chiSquare;
+      std::ostringstream name;
+      name << "X (significance " << pruning.chiSquare.value() << ")";
+      print(name.str(), options);
+    }
+    if (pruning.costComplexity) {
+      PruningOptions options = pre;
+      options.costComplexity = true;
+      options.alpha = pruning.alpha;
+      print("C", options);
+    }
+    if ((bool)pruning.reducedError + (bool)pruning.chiSquare + pruning.costComplexity > 1) {
+      print("All", pruning);
+    }
+    std::cout << std::endl;
+  }
+}
+
+void solve(const std::vector<DatasetRow> dataset, const PruningOptions& pruning, const ForestOptions& forest) {
+  rnde.seed(forest.seed);
   std::vector<DatasetRow> train, test;
   splitTrainTest<DatasetRow, Label>(dataset, DatasetRow::labelSelector, train, test, 0.8);
+  std::cout << "Seed: " << forest.seed << std::endl;
 
-  double trainAccuracy = calculateAccuracy(train, train);
+  if (forest.trees) {
+    RandomForest model(forest.trees, pruning, forest.seed, forest.threads);
+    model.train(train);
+    std::cout << "Random Forest: " << forest.trees << " trees, " << model.getNodes() << " nodes" << std::endl
+              << "   Out-of-Bag Accuracy: " << model.getOobAccuracy() * 100 << "%" << std::endl
+              << std::endl;
+  } else {
+    reportPruning(train, pruning);
+  }
+
+  double trainAccuracy = calculateAccuracy(train, train, pruning, forest);
   std::cout << "1. Train Set Accuracy:" << std::endl
             << "   Accuracy: " << trainAccuracy * 100 << "%" << std::endl;
 
   int K = 10;
   double mean, stdev;
-  std::vector<double> accuracies = calculateKFoldAccuracy(train, K, mean, stdev);
+  std::vector<double> accuracies = calculateKFoldAccuracy(train, pruning, forest, K, mean, stdev);
   std::cout << K << "-Fold Cross-Validation Results:" << std::endl;
   for (size_t i = 0; i < accuracies.size(); i++) {
     std::cout << "    Accuracy Fold " << (i+1) << ": "<< accuracies[i] * 100 << "%"  << std::endl;
@@ -308,7 +1555,7 @@ void solve(const std::vector<DatasetRow> dataset) {
             << "    Average Accuracy: "<< mean * 100 << "%" << std::endl
             << "    Standard Deviation: "<< stdev * 100 << "%" << std::endl;
 
-  double testAccuracy = calculateAccuracy(train, test);
+  double testAccuracy = calculateAccuracy(train, test, pruning, forest);
   std::cout << "2. Test Set Accuracy:" << std::endl
             << "   Accuracy: " << testAccuracy * 100 << "%" << std::endl;
 }
@@ -320,11 +1567,25 @@ int main(int argc, char* argv[]) {
     }
 
     const std::string filename = argv[1];
-    const int mode = argc >= 3 ? std::atoi(argv[2]) : 0;
+    ForestOptions forest;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "-forest" && i + 1 < argc) {
+        forest.trees = std::stoul(argv[++i]);
+      } else if (arg == "-seed" && i + 1 < argc) {
+        forest.seed = std::stoull(argv[++i]);
+      } else if (arg == "-threads" && i + 1 < argc) {
+        forest.threads = std::stoul(argv[++i]);
+      } else {
+        args.push_back(arg);
+      }
+    }
+    const PruningOptions pruning = PruningOptions::parse(args, forest.trees != 0);
 
     const CSV csv = CSVReader::readFile(filename);
-    const std::vector<DatasetRow> dataset = DatasetReader::readCSV(csv, mode);
-    solve(dataset);
+    const std::vector<DatasetRow> dataset = DatasetReader::readCSV(csv);
+    solve(dataset, pruning, forest);
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
     return -1;